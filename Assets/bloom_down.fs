@@ -0,0 +1,19 @@
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+out vec4 finalColor;
+
+uniform sampler2D texture0;
+uniform vec2 halfpixel; // Half a texel of the source
+
+// Dual filter downsample: the center and four diagonal taps, each between four texels
+void main()
+{
+    vec3 sum = texture(texture0, fragTexCoord).rgb * 4.0;
+    sum += texture(texture0, fragTexCoord - halfpixel).rgb;
+    sum += texture(texture0, fragTexCoord + halfpixel).rgb;
+    sum += texture(texture0, fragTexCoord + vec2(halfpixel.x, -halfpixel.y)).rgb;
+    sum += texture(texture0, fragTexCoord - vec2(halfpixel.x, -halfpixel.y)).rgb;
+    finalColor = vec4(sum / 8.0, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+out vec4 finalColor;
+
+uniform sampler2D texture0;
+uniform vec2 halfpixel; // Half a texel of the source
+
+// Dual filter upsample: a ring of eight taps, the diagonal ones weighted twice
+void main()
+{
+    vec3 sum = texture(texture0, fragTexCoord + vec2(-halfpixel.x * 2.0, 0.0)).rgb;
+    sum += texture(texture0, fragTexCoord + vec2(-halfpixel.x, halfpixel.y)).rgb * 2.0;
+    sum += texture(texture0, fragTexCoord + vec2(0.0, halfpixel.y * 2.0)).rgb;
+    sum += texture(texture0, fragTexCoord + vec2(halfpixel.x, halfpixel.y)).rgb * 2.0;
+    sum += texture(texture0, fragTexCoord + vec2(halfpixel.x * 2.0, 0.0)).rgb;
+    sum += texture(texture0, fragTexCoord + vec2(halfpixel.x, -halfpixel.y)).rgb * 2.0;
+    sum += texture(texture0, fragTexCoord + vec2(0.0, -halfpixel.y * 2.0)).rgb;
+    sum += texture(texture0, fragTexCoord + vec2(-halfpixel.x, -halfpixel.y)).rgb * 2.0;
+    finalColor = vec4(sum / 12.0, 1.0);
+}
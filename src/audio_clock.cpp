@@ -0,0 +1,35 @@
+#include "audio_clock.h"
+#include <algorithm>
+#include <cmath>
+
+void ResyncAudioClock(AudioClock& clock, Music music, double time)
+{
+    float length = GetMusicTimeLength(music);
+    clock.loops = length > 0.0f ? int(time / length) : 0;
+    clock.played = float(time - double(clock.loops) * length);
+    clock.time = time;
+    SeekMusicStream(music, clock.played);
+}
+
+double UpdateAudioClock(AudioClock& clock, Music music, float frame_time)
+{
+    float length = GetMusicTimeLength(music);
+    float played = GetMusicTimePlayed(music);
+    if (played + length * 0.5f < clock.played) { // Looped back to the start
+        clock.loops++;
+    }
+    clock.played = played;
+    double music_time = double(clock.loops) * length + played;
+
+    double previous_time = clock.time;
+    clock.time += frame_time;
+    double drift = music_time - clock.time;
+    if (std::abs(drift) > AUDIO_CLOCK_MAX_DRIFT) { // Stalled or skipped, follow the music
+        clock.time = music_time;
+    }
+    else {
+        double correction = 1.0 - std::exp(-AUDIO_CLOCK_CORRECTION_RATE * frame_time); // The same per second at any frame rate
+        clock.time = std::max(clock.time + drift * correction, previous_time);
+    }
+    return clock.time;
+}
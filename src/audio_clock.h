@@ -0,0 +1,21 @@
+#pragma once
+#include "raylib.h"
+
+#define AUDIO_CLOCK_CORRECTION_RATE 6.0 // Per second, the drift from the music position shrinks by e every 1/6 s
+#define AUDIO_CLOCK_MAX_DRIFT 0.2 // Seconds away from the music position past which the clock jumps to it
+
+// Position in the music, for the game to keep time with what is heard.
+// GetMusicTimePlayed only moves when the stream is refilled, so the clock runs on the frame time
+// and is pulled toward the played position at a steady rate: it advances smoothly and doesn't
+// drift from the music whatever the frame rate does. It only jumps when the music stalls or skips.
+// Counts the loops of the track, the time keeps growing past its end.
+struct AudioClock {
+    double time = 0.0; // Seconds since the start of the track, across loops
+    float played = 0.0f; // Position in the track at the last update
+    int loops = 0;
+};
+
+// Seeks the music to time and starts the clock from there
+void ResyncAudioClock(AudioClock& clock, Music music, double time);
+// Returns the clock time, frame_time is the time since the previous update
+double UpdateAudioClock(AudioClock& clock, Music music, float frame_time);
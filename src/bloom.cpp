@@ -0,0 +1,144 @@
+#include "bloom.h"
+#include <algorithm>
+
+static void UnloadBloomLevels(Bloom& bloom)
+{
+    for (int i = 0; i < bloom.nlevels; i++) {
+        UnloadRenderTexture(bloom.levels[i]);
+        bloom.levels[i] = {};
+    }
+    bloom.nlevels = 0;
+}
+
+static void LoadBloomLevels(Bloom& bloom)
+{
+    bloom.nlevels = 0;
+    if (bloom.quality == BloomQuality::Off) {
+        return;
+    }
+    int nlevels = bloom.quality == BloomQuality::High ? BLOOM_HIGH_LEVELS : BLOOM_LOW_LEVELS;
+    int first_shift = bloom.quality == BloomQuality::High ? 0 : 1;
+    for (int i = 0; i < nlevels; i++) {
+        int width = std::max(bloom.width >> (i + first_shift), 1);
+        int height = std::max(bloom.height >> (i + first_shift), 1);
+        bloom.levels[i] = LoadRenderTexture(width, height);
+        SetTextureFilter(bloom.levels[i].texture, TEXTURE_FILTER_BILINEAR);
+        SetTextureWrap(bloom.levels[i].texture, TEXTURE_WRAP_CLAMP);
+        bloom.nlevels++;
+    }
+}
+
+// Draws the whole of source over the whole of the current target, through the current shader
+static void DrawPass(Texture2D source, int width, int height)
+{
+    DrawTexturePro(
+        source,
+        Rectangle{ 0, 0, float(source.width), -float(source.height) },
+        Rectangle{ 0, 0, float(width), float(height) },
+        Vector2{ 0.0f, 0.0f },
+        0.0f,
+        WHITE
+    );
+}
+
+void LoadBloom(Bloom& bloom, int width, int height, BloomQuality quality, ShaderCache const& shaders)
+{
+    bloom.threshold_shader = LoadCachedShader(shaders, "Assets/threshold.fs");
+    bloom.down_shader = LoadCachedShader(shaders, "Assets/bloom_down.fs");
+    bloom.up_shader = LoadCachedShader(shaders, "Assets/bloom_up.fs");
+    bloom.down_halfpixel_loc = GetShaderLocation(bloom.down_shader, "halfpixel");
+    bloom.up_halfpixel_loc = GetShaderLocation(bloom.up_shader, "halfpixel");
+    bloom.width = width;
+    bloom.height = height;
+    bloom.quality = quality;
+    LoadBloomLevels(bloom);
+}
+
+void UnloadBloom(Bloom& bloom)
+{
+    UnloadBloomLevels(bloom);
+    UnloadShader(bloom.threshold_shader);
+    UnloadShader(bloom.down_shader);
+    UnloadShader(bloom.up_shader);
+}
+
+void ResizeBloom(Bloom& bloom, int width, int height, BloomQuality quality)
+{
+    if (width == bloom.width && height == bloom.height && quality == bloom.quality) {
+        return;
+    }
+    UnloadBloomLevels(bloom);
+    bloom.width = width;
+    bloom.height = height;
+    bloom.quality = quality;
+    LoadBloomLevels(bloom);
+}
+
+Texture2D const* RenderBloom(Bloom& bloom, Texture2D scene)
+{
+    ThresholdBloom(bloom, scene);
+    return BlurBloom(bloom);
+}
+
+bool ThresholdBloom(Bloom& bloom, Texture2D scene)
+{
+    if (!bloom.nlevels) {
+        return false;
+    }
+    RenderTexture2D& first = bloom.levels[0];
+    BeginTextureMode(first);
+        ClearBackground(BLANK);
+        BeginShaderMode(bloom.threshold_shader);
+            DrawPass(scene, first.texture.width, first.texture.height);
+        EndShaderMode();
+    EndTextureMode();
+    return true;
+}
+
+Texture2D const* BlurBloom(Bloom& bloom)
+{
+    if (!bloom.nlevels) {
+        return nullptr;
+    }
+    for (int i = 1; i < bloom.nlevels; i++) {
+        Texture2D source = bloom.levels[i - 1].texture;
+        Vector2 halfpixel = { 0.5f / source.width, 0.5f / source.height };
+        BeginTextureMode(bloom.levels[i]);
+            BeginShaderMode(bloom.down_shader);
+                SetShaderValue(bloom.down_shader, bloom.down_halfpixel_loc, &halfpixel, SHADER_UNIFORM_VEC2);
+                DrawPass(source, bloom.levels[i].texture.width, bloom.levels[i].texture.height);
+            EndShaderMode();
+        EndTextureMode();
+    }
+
+    // Each level is overwritten with the upsampled one below it, the shader output is opaque
+    for (int i = bloom.nlevels - 1; i > 0; i--) {
+        Texture2D source = bloom.levels[i].texture;
+        Vector2 halfpixel = { 0.5f / source.width, 0.5f / source.height };
+        BeginTextureMode(bloom.levels[i - 1]);
+            BeginShaderMode(bloom.up_shader);
+                SetShaderValue(bloom.up_shader, bloom.up_halfpixel_loc, &halfpixel, SHADER_UNIFORM_VEC2);
+                DrawPass(source, bloom.levels[i - 1].texture.width, bloom.levels[i - 1].texture.height);
+            EndShaderMode();
+        EndTextureMode();
+    }
+    return &bloom.levels[0].texture;
+}
+
+BloomQuality GetNextBloomQuality(BloomQuality quality)
+{
+    switch (quality) {
+    case BloomQuality::Off: return BloomQuality::Low;
+    case BloomQuality::Low: return BloomQuality::High;
+    default: return BloomQuality::Off;
+    }
+}
+
+char const* GetBloomQualityName(BloomQuality quality)
+{
+    switch (quality) {
+    case BloomQuality::Off: return "off";
+    case BloomQuality::Low: return "low";
+    default: return "high";
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "raylib.h"
+#include "shader_cache.h"
+
+#define BLOOM_MAX_LEVELS 4
+#define BLOOM_LOW_LEVELS 3 // From half the scene size down to an eighth
+#define BLOOM_HIGH_LEVELS 4 // From the scene size down to an eighth
+
+enum class BloomQuality {
+    Off,
+    Low,
+    High,
+};
+
+// Dual filter bloom: the bright parts of the scene are thresholded into a first target, blurred
+// down a chain of targets each half the size of the previous one, then back up to the first. Every
+// pass is a handful of bilinear taps over a quarter of the pixels of the pass before.
+// Both qualities go down to an eighth of the scene size, which spreads the bloom as far as the
+// full resolution blur it replaces (see tests/bloom_test.cpp). Low thresholds at half resolution,
+// where thin features averaged with their surroundings can fall under the threshold; High
+// thresholds at full resolution for one more level.
+struct Bloom {
+    BloomQuality quality = BloomQuality::Off;
+    int width = 0; // Of the scene
+    int height = 0;
+    int nlevels = 0;
+    RenderTexture2D levels[BLOOM_MAX_LEVELS] = {}; // levels[0] is the scene size at High quality, half of it at Low
+    Shader threshold_shader = {};
+    Shader down_shader = {};
+    Shader up_shader = {};
+    int down_halfpixel_loc = -1;
+    int up_halfpixel_loc = -1;
+};
+
+void LoadBloom(Bloom& bloom, int width, int height, BloomQuality quality, ShaderCache const& shaders);
+void UnloadBloom(Bloom& bloom);
+// Reallocates the chain for another quality or scene size
+void ResizeBloom(Bloom& bloom, int width, int height, BloomQuality quality);
+// Renders the bloom of scene, to add over it. Returns nullptr when bloom is off.
+// At Low quality the scene is halved by its own filtering as it is thresholded, so give it bilinear filtering.
+Texture2D const* RenderBloom(Bloom& bloom, Texture2D scene);
+// The two halves of RenderBloom, to time them apart
+bool ThresholdBloom(Bloom& bloom, Texture2D scene);
+Texture2D const* BlurBloom(Bloom& bloom);
+BloomQuality GetNextBloomQuality(BloomQuality quality);
+char const* GetBloomQualityName(BloomQuality quality);
@@ -0,0 +1,67 @@
+#include "bullet_pool.h"
+#include <algorithm>
+
+// Only called when no slot is free
+void GrowBulletPool(BulletPool& pool, int capacity)
+{
+    int old_capacity = int(pool.store.alive.size());
+    ResizeEntityStore(pool.store, capacity);
+    for (int slot = old_capacity; slot < capacity; slot++) {
+        pool.store.pos_y[slot] = -999.0f;
+    }
+    pool.dense_index.resize(capacity, -1);
+    pool.free_slots.reserve(capacity);
+    for (int slot = capacity - 1; slot >= old_capacity; slot--) { // Lowest slot on top of the stack
+        pool.free_slots.push_back(slot);
+    }
+    pool.alive_slots.reserve(capacity);
+}
+
+void InitBulletPool(BulletPool& pool, int capacity, int max_capacity)
+{
+    pool = BulletPool{};
+    pool.max_capacity = std::max(capacity, max_capacity);
+    GrowBulletPool(pool, capacity);
+}
+
+void ClearBulletPool(BulletPool& pool)
+{
+    while (!pool.alive_slots.empty()) {
+        ReleaseBullet(pool, pool.alive_slots.back());
+    }
+    std::fill(pool.store.pos_x.begin(), pool.store.pos_x.end(), 0.0f);
+    std::fill(pool.store.pos_y.begin(), pool.store.pos_y.end(), -999.0f);
+}
+
+int AcquireBullet(BulletPool& pool)
+{
+    if (pool.free_slots.empty()) {
+        int capacity = int(pool.store.alive.size());
+        if (capacity >= pool.max_capacity) {
+            pool.drops++;
+            return -1;
+        }
+        GrowBulletPool(pool, std::min(std::max(capacity * 2, 1), pool.max_capacity));
+    }
+    int slot = pool.free_slots.back();
+    pool.free_slots.pop_back();
+    pool.dense_index[slot] = int(pool.alive_slots.size());
+    pool.alive_slots.push_back(slot);
+    pool.high_water = std::max(pool.high_water, int(pool.alive_slots.size()));
+    pool.store.alive[slot] = 1;
+    return slot;
+}
+
+void ReleaseBullet(BulletPool& pool, int slot)
+{
+    int index = pool.dense_index[slot];
+    int last_slot = pool.alive_slots.back();
+    pool.alive_slots[index] = last_slot;
+    pool.dense_index[last_slot] = index;
+    pool.alive_slots.pop_back();
+    pool.dense_index[slot] = -1;
+    pool.store.alive[slot] = 0;
+    pool.store.vel_x[slot] = 0.0f;
+    pool.store.vel_y[slot] = 0.0f;
+    pool.free_slots.push_back(slot);
+}
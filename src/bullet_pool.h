@@ -0,0 +1,26 @@
+#pragma once
+#include "entity_store.h"
+#include <vector>
+
+// Bullets with O(1) acquire and release. Released slots are reused through a free list, and the
+// slots in use are also kept packed in alive_slots for iteration. Grows on demand up to max_capacity,
+// past which new bullets are dropped and counted.
+// Released slots keep their last position and get a zero velocity, so the movement and cull kernels
+// can run over every slot without a mask.
+struct BulletPool {
+    EntityStore store; // Indexed by slot
+    std::vector<int> free_slots;
+    std::vector<int> alive_slots;
+    std::vector<int> dense_index; // Position of each slot in alive_slots
+    int max_capacity = 0;
+    int drops = 0;
+    int high_water = 0; // Most bullets alive at once
+};
+
+void InitBulletPool(BulletPool& pool, int capacity, int max_capacity);
+// Releases every bullet, keeps capacity and counters
+void ClearBulletPool(BulletPool& pool);
+// Returns the slot of the new bullet, or -1 when the pool is full
+int AcquireBullet(BulletPool& pool);
+// Invalidates the order of alive_slots: the last alive slot takes the place of the released one
+void ReleaseBullet(BulletPool& pool, int slot);
@@ -0,0 +1,70 @@
+#include "collision_grid.h"
+#include <algorithm>
+#include <cmath>
+
+struct CellRange {
+    int x0, y0, x1, y1;
+};
+
+CellRange GetCellRange(CollisionGrid const& grid, Rectangle rect)
+{
+    auto cell = [&](float value, float origin, int count) {
+        return std::clamp(int(std::floor((value - origin) / grid.cell_size)), 0, count - 1);
+    };
+    return CellRange{
+        cell(rect.x, grid.area.x, grid.columns),
+        cell(rect.y, grid.area.y, grid.rows),
+        cell(rect.x + rect.width, grid.area.x, grid.columns),
+        cell(rect.y + rect.height, grid.area.y, grid.rows),
+    };
+}
+
+void BuildCollisionGrid(CollisionGrid& grid, Rectangle area, float cell_size, std::span<GridItem const> items)
+{
+    grid.area = area;
+    grid.cell_size = cell_size;
+    grid.columns = std::max(1, int(std::ceil(area.width / cell_size)));
+    grid.rows = std::max(1, int(std::ceil(area.height / cell_size)));
+    int ncells = grid.columns * grid.rows;
+
+    // Counting sort of the items into their cells: count, prefix sum, then fill
+    grid.cell_start.assign(ncells + 1, 0);
+    for (GridItem const& item : items) {
+        CellRange range = GetCellRange(grid, item.rect);
+        for (int y = range.y0; y <= range.y1; y++) {
+            for (int x = range.x0; x <= range.x1; x++) {
+                grid.cell_start[y * grid.columns + x + 1]++;
+            }
+        }
+    }
+    for (int c = 0; c < ncells; c++) {
+        grid.cell_start[c + 1] += grid.cell_start[c];
+    }
+    grid.ids.resize(grid.cell_start[ncells]);
+    grid.fill.assign(grid.cell_start.begin(), grid.cell_start.end() - 1);
+    for (GridItem const& item : items) {
+        CellRange range = GetCellRange(grid, item.rect);
+        for (int y = range.y0; y <= range.y1; y++) {
+            for (int x = range.x0; x <= range.x1; x++) {
+                grid.ids[grid.fill[y * grid.columns + x]++] = item.id;
+            }
+        }
+    }
+}
+
+void QueryCollisionGrid(CollisionGrid const& grid, Rectangle rect, std::vector<int>& ids)
+{
+    ids.clear();
+    if (grid.ids.empty()) {
+        return;
+    }
+    CellRange range = GetCellRange(grid, rect);
+    for (int y = range.y0; y <= range.y1; y++) {
+        for (int x = range.x0; x <= range.x1; x++) {
+            int c = y * grid.columns + x;
+            ids.insert(ids.end(), grid.ids.begin() + grid.cell_start[c], grid.ids.begin() + grid.cell_start[c + 1]);
+        }
+    }
+    std::ranges::sort(ids);
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
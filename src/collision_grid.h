@@ -0,0 +1,25 @@
+#pragma once
+#include "raylib.h"
+#include <span>
+#include <vector>
+
+struct GridItem {
+    int id;
+    Rectangle rect;
+};
+
+// Uniform grid broad phase over an area, rebuilt from scratch every frame.
+// Items sticking out of the area are clamped into the border cells, so no overlapping pair is missed.
+struct CollisionGrid {
+    Rectangle area;
+    float cell_size;
+    int columns = 0;
+    int rows = 0;
+    std::vector<int> cell_start; // Ids of cell c are ids[cell_start[c]] to ids[cell_start[c + 1] - 1]
+    std::vector<int> ids;
+    std::vector<int> fill; // Scratch for building
+};
+
+void BuildCollisionGrid(CollisionGrid& grid, Rectangle area, float cell_size, std::span<GridItem const> items);
+// Replaces ids with the ids of the items sharing a cell with rect, in ascending order and without duplicates
+void QueryCollisionGrid(CollisionGrid const& grid, Rectangle rect, std::vector<int>& ids);
@@ -0,0 +1,14 @@
+#pragma once
+#include "raylib.h"
+
+struct Entity {
+    bool alive;
+    bool can_move;
+    Vector2 pos;
+    Vector2 velocity;
+    int type;
+    int hp;
+    int hp_max;
+    float last_hit_time;
+    float last_fire_time;
+};
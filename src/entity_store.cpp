@@ -0,0 +1,96 @@
+#include "entity_store.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ENTITY_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENTITY_SIMD_WIDTH 4
+#else
+#define ENTITY_SIMD_WIDTH 1
+#endif
+
+// The vector paths use separate multiply and add, never FMA, so they round exactly like the scalar loops.
+
+void ResizeEntityStore(EntityStore& store, size_t count)
+{
+    store.pos_x.resize(count, 0.0f);
+    store.pos_y.resize(count, 0.0f);
+    store.vel_x.resize(count, 0.0f);
+    store.vel_y.resize(count, 0.0f);
+    store.alive.resize(count, 0);
+    store.cold.resize(count, EntityCold{});
+}
+
+void IntegrateArray(float* pos, float const* vel, size_t count, float dt)
+{
+    size_t i = 0;
+#if ENTITY_SIMD_WIDTH == 8
+    __m256 dt8 = _mm256_set1_ps(dt);
+    for (; i + 8 <= count; i += 8) {
+        __m256 p = _mm256_loadu_ps(pos + i);
+        __m256 v = _mm256_loadu_ps(vel + i);
+        _mm256_storeu_ps(pos + i, _mm256_add_ps(p, _mm256_mul_ps(dt8, v)));
+    }
+#elif ENTITY_SIMD_WIDTH == 4
+    __m128 dt4 = _mm_set1_ps(dt);
+    for (; i + 4 <= count; i += 4) {
+        __m128 p = _mm_loadu_ps(pos + i);
+        __m128 v = _mm_loadu_ps(vel + i);
+        _mm_storeu_ps(pos + i, _mm_add_ps(p, _mm_mul_ps(dt4, v)));
+    }
+#endif
+    for (; i < count; i++) {
+        pos[i] += dt * vel[i];
+    }
+}
+
+void IntegrateEntities(EntityStore& store, float dt)
+{
+    IntegrateArray(store.pos_x.data(), store.vel_x.data(), store.pos_x.size(), dt);
+    IntegrateArray(store.pos_y.data(), store.vel_y.data(), store.pos_y.size(), dt);
+}
+
+void CullEntitiesOutsideX(EntityStore& store, float min_x, float max_x, float half_width)
+{
+    float const* pos_x = store.pos_x.data();
+    uint8_t* alive = store.alive.data();
+    size_t count = store.pos_x.size();
+    size_t i = 0;
+#if ENTITY_SIMD_WIDTH == 8
+    __m256 min8 = _mm256_set1_ps(min_x);
+    __m256 max8 = _mm256_set1_ps(max_x);
+    __m256 half8 = _mm256_set1_ps(half_width);
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(pos_x + i);
+        __m256 right = _mm256_cmp_ps(_mm256_sub_ps(x, half8), max8, _CMP_GE_OQ);
+        __m256 left = _mm256_cmp_ps(_mm256_add_ps(x, half8), min8, _CMP_LE_OQ);
+        int outside = _mm256_movemask_ps(_mm256_or_ps(right, left));
+        for (int k = 0; outside; k++, outside >>= 1) {
+            if (outside & 1) {
+                alive[i + k] = 0;
+            }
+        }
+    }
+#elif ENTITY_SIMD_WIDTH == 4
+    __m128 min4 = _mm_set1_ps(min_x);
+    __m128 max4 = _mm_set1_ps(max_x);
+    __m128 half4 = _mm_set1_ps(half_width);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(pos_x + i);
+        __m128 right = _mm_cmpge_ps(_mm_sub_ps(x, half4), max4);
+        __m128 left = _mm_cmple_ps(_mm_add_ps(x, half4), min4);
+        int outside = _mm_movemask_ps(_mm_or_ps(right, left));
+        for (int k = 0; outside; k++, outside >>= 1) {
+            if (outside & 1) {
+                alive[i + k] = 0;
+            }
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (pos_x[i] - half_width >= max_x || pos_x[i] + half_width <= min_x) {
+            alive[i] = 0;
+        }
+    }
+}
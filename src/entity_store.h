@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fields only read on collisions, spawns and draws
+struct EntityCold {
+    int type;
+    int hp;
+    int hp_max;
+    float last_hit_time;
+    float last_fire_time;
+};
+
+// Entities as a structure of arrays: what the per-frame passes touch lives in separate packed
+// arrays so they stream through cache and vectorize, the rest goes in a cold side table.
+struct EntityStore {
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> vel_x;
+    std::vector<float> vel_y;
+    std::vector<uint8_t> alive;
+    std::vector<EntityCold> cold;
+};
+
+void ResizeEntityStore(EntityStore& store, size_t count);
+// pos += dt * velocity for every entity, alive or not: dead ones must have a zero velocity
+void IntegrateEntities(EntityStore& store, float dt);
+// Kills the entities of half width half_width that are fully outside [min_x, max_x]
+void CullEntitiesOutsideX(EntityStore& store, float min_x, float max_x, float half_width);
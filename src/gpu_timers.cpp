@@ -0,0 +1,107 @@
+#include "gpu_timers.h"
+#include "rlgl.h"
+#include <cstdint>
+
+#if defined(_WIN32) && !defined(_WIN64)
+#define GPU_TIMERS_APIENTRY __stdcall
+#else
+#define GPU_TIMERS_APIENTRY
+#endif
+
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+
+// Loaded through rlgl, raylib doesn't expose its GL loader
+typedef void (GPU_TIMERS_APIENTRY *GenQueriesProc)(int n, unsigned int* ids);
+typedef void (GPU_TIMERS_APIENTRY *DeleteQueriesProc)(int n, unsigned int const* ids);
+typedef void (GPU_TIMERS_APIENTRY *BeginQueryProc)(unsigned int target, unsigned int id);
+typedef void (GPU_TIMERS_APIENTRY *EndQueryProc)(unsigned int target);
+typedef void (GPU_TIMERS_APIENTRY *GetQueryObjectivProc)(unsigned int id, unsigned int pname, int* params);
+typedef void (GPU_TIMERS_APIENTRY *GetQueryObjectui64vProc)(unsigned int id, unsigned int pname, uint64_t* params);
+
+static GenQueriesProc glGenQueries = nullptr;
+static DeleteQueriesProc glDeleteQueries = nullptr;
+static BeginQueryProc glBeginQuery = nullptr;
+static EndQueryProc glEndQuery = nullptr;
+static GetQueryObjectivProc glGetQueryObjectiv = nullptr;
+static GetQueryObjectui64vProc glGetQueryObjectui64v = nullptr;
+
+void LoadGpuTimers(GpuTimers& timers)
+{
+    timers = {};
+    int version = rlGetVersion();
+    if (version != RL_OPENGL_33 && version != RL_OPENGL_43) {
+        return;
+    }
+    glGenQueries = (GenQueriesProc)rlGetProcAddress("glGenQueries");
+    glDeleteQueries = (DeleteQueriesProc)rlGetProcAddress("glDeleteQueries");
+    glBeginQuery = (BeginQueryProc)rlGetProcAddress("glBeginQuery");
+    glEndQuery = (EndQueryProc)rlGetProcAddress("glEndQuery");
+    glGetQueryObjectiv = (GetQueryObjectivProc)rlGetProcAddress("glGetQueryObjectiv");
+    glGetQueryObjectui64v = (GetQueryObjectui64vProc)rlGetProcAddress("glGetQueryObjectui64v");
+    if (!glGenQueries || !glDeleteQueries || !glBeginQuery || !glEndQuery || !glGetQueryObjectiv || !glGetQueryObjectui64v) {
+        return;
+    }
+    glGenQueries(GPU_TIMER_LATENCY * int(ProfilePhase::Count), &timers.queries[0][0]);
+    timers.is_supported = true;
+}
+
+void UnloadGpuTimers(GpuTimers& timers)
+{
+    if (timers.is_supported) {
+        glDeleteQueries(GPU_TIMER_LATENCY * int(ProfilePhase::Count), &timers.queries[0][0]);
+    }
+    timers = {};
+}
+
+void BeginGpuFrame(GpuTimers& timers, Profiler& profiler)
+{
+    if (!timers.is_supported) {
+        return;
+    }
+    EndGpuPhase(timers);
+    timers.slot = (timers.slot + 1) % GPU_TIMER_LATENCY;
+    ProfileFrame* frame = GetProfileFrame(profiler, timers.frame[timers.slot]);
+    for (int phase = 0; phase < int(ProfilePhase::Count); phase++) {
+        if (!timers.is_issued[timers.slot][phase]) {
+            continue;
+        }
+        timers.is_issued[timers.slot][phase] = false;
+        unsigned int query = timers.queries[timers.slot][phase];
+        int is_available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if (is_available && frame) {
+            uint64_t ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            frame->gpu_ms[phase] = float(double(ns) / 1.0e6);
+        }
+    }
+    timers.frame[timers.slot] = profiler.nframes - 1;
+}
+
+void BeginGpuPhase(GpuTimers& timers, ProfilePhase phase)
+{
+    if (!timers.is_supported) {
+        return;
+    }
+    EndGpuPhase(timers);
+    // A query is only issued once per frame, a phase entered again isn't timed again
+    if (timers.is_issued[timers.slot][int(phase)]) {
+        return;
+    }
+    rlDrawRenderBatchActive();
+    glBeginQuery(GL_TIME_ELAPSED, timers.queries[timers.slot][int(phase)]);
+    timers.is_issued[timers.slot][int(phase)] = true;
+    timers.active_phase = int(phase);
+}
+
+void EndGpuPhase(GpuTimers& timers)
+{
+    if (timers.active_phase < 0) {
+        return;
+    }
+    rlDrawRenderBatchActive();
+    glEndQuery(GL_TIME_ELAPSED);
+    timers.active_phase = -1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "profiler.h"
+
+#define GPU_TIMER_LATENCY 4 // Frames a query is given to come back before its slot is reused
+
+// GL timer queries around the render phases, read back GPU_TIMER_LATENCY frames later into the
+// profiler frame they were issued in, so the CPU never waits for them. Results that aren't back by
+// then are dropped. Needs OpenGL 3.3, does nothing on older contexts.
+struct GpuTimers {
+    bool is_supported = false;
+    unsigned int queries[GPU_TIMER_LATENCY][int(ProfilePhase::Count)] = {};
+    bool is_issued[GPU_TIMER_LATENCY][int(ProfilePhase::Count)] = {};
+    size_t frame[GPU_TIMER_LATENCY] = {}; // Profiler frame of the queries in the slot
+    size_t slot = 0; // Of the current frame
+    int active_phase = -1; // Queries can't nest
+};
+
+// After the window is created
+void LoadGpuTimers(GpuTimers& timers);
+void UnloadGpuTimers(GpuTimers& timers);
+// After BeginProfileFrame: collects the results of the slot the frame reuses
+void BeginGpuFrame(GpuTimers& timers, Profiler& profiler);
+// Draws what is pending in the render batch first, so earlier draws don't count in the phase
+void BeginGpuPhase(GpuTimers& timers, ProfilePhase phase);
+void EndGpuPhase(GpuTimers& timers);
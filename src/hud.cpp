@@ -0,0 +1,86 @@
+#include "hud.h"
+#include <cstring>
+
+static bool operator==(HudLine const& a, HudLine const& b)
+{
+    return a.x == b.x && a.y == b.y && a.font_size == b.font_size && a.align == b.align
+        && a.color.r == b.color.r && a.color.g == b.color.g && a.color.b == b.color.b && a.color.a == b.color.a
+        && !std::strcmp(a.text, b.text);
+}
+
+static bool operator==(HudLayer const& a, HudLayer const& b)
+{
+    if (a.nlines != b.nlines) {
+        return false;
+    }
+    for (int i = 0; i < a.nlines; i++) {
+        if (!(a.lines[i] == b.lines[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LoadHud(Hud& hud, int width, int height)
+{
+    hud.target = LoadRenderTexture(width, height);
+    SetTextureFilter(hud.target.texture, TEXTURE_FILTER_BILINEAR); // For the scaled down scene targets
+    hud.drawn.nlines = 0;
+    hud.next.nlines = 0;
+    hud.is_drawn = false;
+}
+
+void UnloadHud(Hud& hud)
+{
+    UnloadRenderTexture(hud.target);
+    hud.target = {};
+    hud.is_drawn = false;
+}
+
+void BeginHud(Hud& hud)
+{
+    hud.next.nlines = 0;
+}
+
+bool RenderHud(Hud& hud)
+{
+    if (hud.is_drawn && hud.next == hud.drawn) {
+        return false;
+    }
+    BeginTextureMode(hud.target);
+        ClearBackground(BLANK);
+        int previous_end = 0;
+        for (int i = 0; i < hud.next.nlines; i++) {
+            HudLine const& line = hud.next.lines[i];
+            int width = MeasureText(line.text, line.font_size);
+            int x = line.x;
+            if (line.align == HudAlign::Center) {
+                x = (2 * line.x - width) / 2;
+            }
+            else if (line.align == HudAlign::After) {
+                x = previous_end + line.x;
+            }
+            DrawText(line.text, x, line.y, line.font_size, line.color);
+            previous_end = x + width;
+        }
+    EndTextureMode();
+    hud.drawn = hud.next;
+    hud.is_drawn = true;
+    hud.renders++;
+    return true;
+}
+
+void DrawHud(Hud const& hud, float width, float height)
+{
+    if (!hud.drawn.nlines) {
+        return;
+    }
+    DrawTexturePro(
+        hud.target.texture,
+        Rectangle{ 0, 0, float(hud.target.texture.width), -float(hud.target.texture.height) },
+        Rectangle{ 0, 0, width, height },
+        Vector2{ 0.0f, 0.0f },
+        0.0f,
+        WHITE
+    );
+}
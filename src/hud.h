@@ -0,0 +1,63 @@
+#pragma once
+#include "raylib.h"
+#include <format>
+
+#define HUD_MAX_LINES 40
+#define HUD_LINE_CAPACITY 48 // Longer texts are cut
+
+enum class HudAlign {
+    Left, // x is the left edge
+    Center, // x is the center
+    After, // x is the gap after the end of the previous line
+};
+
+struct HudLine {
+    char text[HUD_LINE_CAPACITY];
+    int x;
+    int y;
+    int font_size;
+    Color color;
+    HudAlign align;
+};
+
+struct HudLayer {
+    HudLine lines[HUD_MAX_LINES];
+    int nlines = 0;
+};
+
+// Texts drawn over the game, kept in a render texture that is only redrawn when they change.
+// Each frame the lines are formatted into fixed buffers, without allocating, and compared with the
+// ones in the texture: a frame where no value changed doesn't measure or draw a single glyph.
+struct Hud {
+    RenderTexture2D target = {};
+    HudLayer drawn; // In target
+    HudLayer next; // Being added this frame
+    bool is_drawn = false;
+    int renders = 0; // Times target was redrawn
+};
+
+void LoadHud(Hud& hud, int width, int height);
+void UnloadHud(Hud& hud);
+// Starts the lines of a new frame
+void BeginHud(Hud& hud);
+// Redraws target if the lines added since BeginHud differ from the ones in it. Returns true when it did.
+// Not within another texture mode.
+bool RenderHud(Hud& hud);
+// Draws target over the current target, scaled to width x height
+void DrawHud(Hud const& hud, float width, float height);
+
+template<class... Args>
+void AddHudText(Hud& hud, HudAlign align, int x, int y, int font_size, Color color, std::format_string<Args...> fmt, Args&&... args)
+{
+    if (hud.next.nlines == HUD_MAX_LINES) {
+        return;
+    }
+    HudLine& line = hud.next.lines[hud.next.nlines++];
+    char* end = std::format_to_n(line.text, HUD_LINE_CAPACITY - 1, fmt, std::forward<Args>(args)...).out;
+    *end = '\0';
+    line.x = x;
+    line.y = y;
+    line.font_size = font_size;
+    line.color = color;
+    line.align = align;
+}
@@ -0,0 +1,104 @@
+#include "job_system.h"
+
+JobSystem::JobSystem(int nworkers)
+{
+    for (int i = 0; i < nworkers; i++) {
+        queues.push_back(std::make_unique<JobQueue>());
+    }
+    for (int i = 0; i < nworkers; i++) {
+        workers.emplace_back([this, i](std::stop_token stop) { Work(stop, size_t(i)); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    for (std::jthread& worker : workers) {
+        worker.request_stop();
+    }
+    job_signal.fetch_add(1, std::memory_order_release);
+    job_signal.notify_all();
+    workers.clear(); // Joins
+}
+
+void JobSystem::Run(Job const& job, size_t count, size_t grain)
+{
+    if (!count) {
+        return;
+    }
+    if (queues.empty()) {
+        for (size_t begin = 0; begin < count; begin += grain) {
+            job.run(job.fn, begin, std::min(begin + grain, count));
+        }
+        return;
+    }
+
+    size_t njobs = (count + grain - 1) / grain;
+    if (njobs == 1) { // Nothing to share, waking workers would only cost
+        job.run(job.fn, 0, count);
+        return;
+    }
+
+    // Consecutive ranges go to the same queue, so a worker mostly walks contiguous memory
+    pending.store(njobs, std::memory_order_relaxed);
+    size_t per_queue = (njobs + queues.size() - 1) / queues.size();
+    for (size_t i = 0; i < njobs; i++) {
+        Job range = job;
+        range.begin = i * grain;
+        range.end = std::min(range.begin + grain, count);
+        JobQueue& queue = *queues[i / per_queue];
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back(range);
+    }
+    // The calling thread takes one of the jobs, enough workers are woken for the others
+    job_signal.fetch_add(1, std::memory_order_release);
+    size_t nwakes = std::min(njobs - 1, workers.size());
+    for (size_t i = 0; i < nwakes; i++) {
+        job_signal.notify_one();
+    }
+
+    while (size_t left = pending.load(std::memory_order_acquire)) {
+        if (!RunOneJob(0, false)) {
+            pending.wait(left, std::memory_order_acquire); // The last ones are running on workers
+        }
+    }
+}
+
+bool JobSystem::RunOneJob(size_t first, bool owns_first)
+{
+    Job job;
+    bool found = false;
+    for (size_t k = 0; k < queues.size() && !found; k++) {
+        JobQueue& queue = *queues[(first + k) % queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (k == 0 && owns_first) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        else { // Steals from the other end, away from the owner
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+    job.run(job.fn, job.begin, job.end);
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pending.notify_all();
+    }
+    return true;
+}
+
+void JobSystem::Work(std::stop_token stop, size_t iqueue)
+{
+    while (!stop.stop_requested()) {
+        uint32_t signal = job_signal.load(std::memory_order_acquire);
+        if (!RunOneJob(iqueue, true)) {
+            job_signal.wait(signal, std::memory_order_acquire);
+        }
+    }
+}
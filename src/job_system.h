@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// A range of items of a ParallelFor
+struct Job {
+    void (*run)(void const* fn, size_t begin, size_t end);
+    void const* fn;
+    size_t begin;
+    size_t end;
+};
+
+// Fixed pool of worker threads, each with its own queue of jobs. A worker takes its jobs from the
+// front of its queue, and when it runs out steals from the back of the others, so uneven ranges
+// still keep every core busy. The thread waiting on a batch runs jobs too, stealing like a worker,
+// and runs a batch of a single job by itself.
+class JobSystem {
+public:
+    // With no workers, every job runs on the calling thread
+    explicit JobSystem(int nworkers);
+    JobSystem(JobSystem const&) = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+    ~JobSystem();
+
+    int WorkerCount() const { return int(workers.size()); }
+
+    // Calls fn(begin, end) over [0, count) in ranges of grain items and returns once all are done.
+    // Ranges run in any order and concurrently, so fn must only write to what its range owns;
+    // merging the results in range order afterwards keeps the outcome independent of the threads.
+    // One batch at a time, and fn must not call ParallelFor.
+    template <typename Fn>
+    void ParallelFor(size_t count, size_t grain, Fn const& fn)
+    {
+        Job job = {
+            .run = [](void const* context, size_t begin, size_t end) { (*static_cast<Fn const*>(context))(begin, end); },
+            .fn = &fn,
+        };
+        Run(job, count, std::max<size_t>(grain, 1));
+    }
+
+private:
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Run(Job const& job, size_t count, size_t grain);
+    // Runs one job, looking in the queue first first, returns false when every queue is empty.
+    // Jobs are taken from the front of the queue only by its owner, the others steal from the back.
+    bool RunOneJob(size_t first, bool owns_first);
+    void Work(std::stop_token stop, size_t iqueue);
+
+    std::vector<std::unique_ptr<JobQueue>> queues; // One per worker
+    std::atomic<uint32_t> job_signal = 0; // Bumped when jobs are queued, to wait on
+    std::atomic<size_t> pending = 0; // Jobs of the current batch not finished yet
+    std::vector<std::jthread> workers;
+};
+
+// Runs ranges on the job system when there is one, on the calling thread in order otherwise
+template <typename Fn>
+void ParallelFor(JobSystem* jobs, size_t count, size_t grain, Fn const& fn)
+{
+    if (jobs) {
+        jobs->ParallelFor(count, grain, fn);
+        return;
+    }
+    for (size_t begin = 0; begin < count; begin += grain) {
+        fn(begin, std::min(begin + grain, count));
+    }
+}
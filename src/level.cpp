@@ -0,0 +1,157 @@
+#include "level.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <queue>
+#include <stdexcept>
+
+static_assert(sizeof(LevelSpawn) == 16, "LevelSpawn layout is part of the compiled level format");
+static_assert(sizeof(LevelFileHeader) == 16, "LevelFileHeader layout is part of the compiled level format");
+
+LevelSpawn MakeSpawn(Event const& event, int itrack, double start, double end)
+{
+    LevelSpawn spawn;
+    spawn.x = float(start * PIXEL_PER_SECOND);
+    spawn.y = ((float)event.note - MIDI_NOTE_DEF) * 0.1f * PIXEL_PER_UNIT;
+    spawn.type = itrack;
+    spawn.hp = std::min(1 + int((end - start) / SPAWN_HP_SUSTAIN_TIME), SPAWN_HP_MAX);
+    return spawn;
+}
+
+Level BuildLevel(Midi const& midi)
+{
+    Level level;
+    level.storage.reserve(midi.events.size());
+    // K-way merge of the tracks, each already sorted by tick, into a single stream sorted by tick.
+    // Ties go to the lowest track so the order is stable.
+    using Cursor = std::pair<int, int>; // Tick, track
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heads;
+    std::vector<size_t> next_event(midi.tracks.size(), 0);
+    for (int i = 0; i < midi.tracks.size(); i++) {
+        if (!midi.tracks[i].events.empty()) {
+            heads.push({ midi.tracks[i].events[0].start_ticks, i });
+        }
+    }
+    while (!heads.empty()) {
+        int i = heads.top().second;
+        heads.pop();
+        Track const& track = midi.tracks[i];
+        Event const& event = track.events[next_event[i]++];
+        if (next_event[i] < track.events.size()) {
+            heads.push({ track.events[next_event[i]].start_ticks, i });
+        }
+        double start = TicksToSeconds(midi, event.start_ticks);
+        double end = TicksToSeconds(midi, event.start_ticks + event.duration_ticks);
+        level.storage.push_back(MakeSpawn(event, i, start, end));
+    }
+    level.spawns = level.storage;
+    level.length = float(TicksToSeconds(midi, midi.ticklen) * PIXEL_PER_SECOND);
+    return level;
+}
+
+Level LoadLevelMidi(std::string const& filepath)
+{
+    MappedFile file(filepath); // Must outlive midi, which reads straight from the mapping
+    if (file.Size() > MAX_LEVEL_FILE_SIZE) {
+        throw std::runtime_error(std::format("Level file too big: {} ", filepath));
+    }
+    Midi midi = LoadMidi(file.Data());
+    return BuildLevel(midi);
+}
+
+Level LoadCompiledLevel(std::string const& filepath)
+{
+    Level level;
+    level.file = MappedFile(filepath);
+    std::span<uint8_t const> data = level.file.Data();
+    LevelFileHeader header;
+    if (data.size() < sizeof(header)) {
+        throw std::runtime_error(std::format("Compiled level too small: {}", filepath));
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, LEVEL_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(std::format("Not a compiled level: {}", filepath));
+    }
+    if (header.version != LEVEL_FILE_VERSION) {
+        throw std::runtime_error(std::format("Compiled level version {} unsupported, expected {}: {}", header.version, LEVEL_FILE_VERSION, filepath));
+    }
+    if (data.size() != sizeof(header) + size_t(header.nspawns) * sizeof(LevelSpawn)) {
+        throw std::runtime_error(std::format("Compiled level size mismatch: {}", filepath));
+    }
+    // The header keeps the table 16 bytes aligned within the page aligned mapping
+    level.spawns = { reinterpret_cast<LevelSpawn const*>(data.data() + sizeof(header)), header.nspawns };
+    level.length = header.length;
+    return level;
+}
+
+void SaveCompiledLevel(Level const& level, std::string const& filepath)
+{
+    LevelFileHeader header;
+    std::memcpy(header.magic, LEVEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = LEVEL_FILE_VERSION;
+    header.nspawns = uint32_t(level.spawns.size());
+    header.length = level.length;
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::format("Can't open file for writing: {}", filepath));
+    }
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(level.spawns.data()), level.spawns.size_bytes());
+    if (!file) {
+        throw std::runtime_error(std::format("Error writing file: {}", filepath));
+    }
+}
+
+std::string GetCompiledLevelPath(std::string const& midi_filepath)
+{
+    return std::filesystem::path(midi_filepath).replace_extension(LEVEL_FILE_EXTENSION).string();
+}
+
+uint64_t HashLevel(Level const& level)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto hash_bytes = [&](void const* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<uint8_t const*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    hash_bytes(&level.length, sizeof(level.length));
+    hash_bytes(level.spawns.data(), level.spawns.size_bytes());
+    return hash;
+}
+
+bool HasFreshCompiledLevel(std::string const& midi_filepath)
+{
+    namespace fs = std::filesystem;
+    std::string compiled_filepath = GetCompiledLevelPath(midi_filepath);
+    std::error_code ec;
+    bool has_compiled = fs::exists(compiled_filepath, ec);
+    bool has_midi = fs::exists(midi_filepath, ec);
+    if (has_compiled && has_midi) {
+        auto compiled_time = fs::last_write_time(compiled_filepath, ec);
+        auto midi_time = fs::last_write_time(midi_filepath, ec);
+        has_compiled = !ec && compiled_time >= midi_time;
+    }
+    return has_compiled;
+}
+
+Level LoadLevel(std::string const& midi_filepath)
+{
+    if (HasFreshCompiledLevel(midi_filepath)) {
+        try {
+            return LoadCompiledLevel(GetCompiledLevelPath(midi_filepath));
+        }
+        catch (std::exception& e) {
+            std::error_code ec;
+            if (!std::filesystem::exists(midi_filepath, ec)) {
+                throw;
+            }
+            std::println("{}, falling back to {}", e.what(), midi_filepath);
+        }
+    }
+    return LoadLevelMidi(midi_filepath);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "mapped_file.h"
+#include "midi.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#define PIXEL_PER_UNIT 100
+#define PIXEL_PER_SECOND 100 // Camera scroll speed, also maps music time to spawn x
+#define MAX_LEVEL_FILE_SIZE 100 * 1024 * 1024
+
+#define SPAWN_HP_SUSTAIN_TIME 1.0f // Seconds a note must be held per extra enemy hp
+#define SPAWN_HP_MAX 5
+
+#define LEVEL_FILE_MAGIC "IMLV"
+#define LEVEL_FILE_VERSION 4
+#define LEVEL_FILE_EXTENSION ".lvl"
+
+// One enemy of the spawn table, already converted to world pixels.
+// Stored as is in compiled level files, so the layout is part of the file format.
+struct LevelSpawn {
+    float x;
+    float y;
+    int32_t type;
+    int32_t hp;
+};
+
+struct LevelFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t nspawns;
+    float length;
+};
+
+struct Level {
+    float length = 0.0f; // In pixels
+    std::span<LevelSpawn const> spawns; // Sorted by x, the order enemies enter the screen
+    // Backing store of spawns: either built from a MIDI file, or a compiled level mapped in memory
+    std::vector<LevelSpawn> storage;
+    MappedFile file;
+};
+
+// Enemy for a note of track itrack, start and end in seconds
+LevelSpawn MakeSpawn(Event const& event, int itrack, double start, double end);
+Level BuildLevel(Midi const& midi);
+Level LoadLevelMidi(std::string const& filepath);
+Level LoadCompiledLevel(std::string const& filepath);
+void SaveCompiledLevel(Level const& level, std::string const& filepath);
+std::string GetCompiledLevelPath(std::string const& midi_filepath);
+// True when the compiled level next to the MIDI file exists and is up to date, or the MIDI file is gone
+bool HasFreshCompiledLevel(std::string const& midi_filepath);
+// FNV-1a of the length and spawn table: identifies a level whatever file it was loaded from
+uint64_t HashLevel(Level const& level);
+// Loads the compiled level next to the MIDI file when it is up to date, parses the MIDI file otherwise.
+Level LoadLevel(std::string const& midi_filepath);
@@ -0,0 +1,248 @@
+#include "level_stream.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <print>
+#include <stdexcept>
+
+static void PushChunk(LevelChunkQueue& queue, int ichunk)
+{
+    size_t tail = queue.tail.load(std::memory_order_relaxed);
+    queue.items[tail % queue.items.size()] = ichunk;
+    queue.tail.store(tail + 1, std::memory_order_release);
+    queue.signal.fetch_add(1, std::memory_order_release);
+    queue.signal.notify_one();
+}
+
+static bool PopChunk(LevelChunkQueue& queue, int& ichunk)
+{
+    size_t head = queue.head.load(std::memory_order_relaxed);
+    if (head == queue.tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    ichunk = queue.items[head % queue.items.size()];
+    queue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+// Blocks until an item is pushed, or returns false once stop is requested
+static bool WaitChunk(LevelChunkQueue& queue, int& ichunk, std::stop_token const& stop)
+{
+    while (!PopChunk(queue, ichunk)) {
+        uint32_t signal = queue.signal.load(std::memory_order_acquire);
+        if (stop.stop_requested()) {
+            return false;
+        }
+        if (PopChunk(queue, ichunk)) {
+            break;
+        }
+        queue.signal.wait(signal, std::memory_order_acquire);
+    }
+    return true;
+}
+
+static void ClearQueue(LevelChunkQueue& queue)
+{
+    queue.head = 0;
+    queue.tail = 0;
+}
+
+LevelStream::LevelStream(std::string const& midi_filepath)
+    : filepath(midi_filepath)
+{
+    try {
+        Open();
+    }
+    catch (std::exception& e) {
+        source = Source::None;
+        open_error = e.what();
+    }
+    for (LevelChunk& chunk : chunks) {
+        chunk.spawns.reserve(LEVEL_CHUNK_CAPACITY);
+    }
+    Start();
+}
+
+// Picks the source like LoadLevel
+void LevelStream::Open()
+{
+    if (HasFreshCompiledLevel(filepath)) {
+        try {
+            level = LoadCompiledLevel(GetCompiledLevelPath(filepath));
+            source = Source::Compiled;
+            return;
+        }
+        catch (std::exception& e) {
+            std::error_code ec;
+            if (!std::filesystem::exists(filepath, ec)) {
+                throw;
+            }
+            std::println("{}, falling back to {}", e.what(), filepath);
+        }
+    }
+    file = MappedFile(filepath);
+    if (file.Size() > MAX_LEVEL_FILE_SIZE) {
+        throw std::runtime_error(std::format("Level file too big: {} ", filepath));
+    }
+    auto midi_or_error = OpenMidiStream(file.Data());
+    if (!midi_or_error) {
+        throw std::runtime_error(std::format("{} at byte {}: {}", midi_or_error.error().reason, midi_or_error.error().offset, filepath));
+    }
+    midi = std::move(*midi_or_error);
+    source = Source::Midi;
+}
+
+LevelStream::~LevelStream()
+{
+    Stop();
+}
+
+LevelChunk const& LevelStream::Receive()
+{
+    int ichunk = 0;
+    WaitChunk(ready_chunks, ichunk, {});
+    return chunks[ichunk];
+}
+
+void LevelStream::Release(LevelChunk const& chunk)
+{
+    PushChunk(free_chunks, int(&chunk - chunks.data()));
+}
+
+void LevelStream::Restart()
+{
+    Stop();
+    if (source == Source::Midi) {
+        midi = *OpenMidiStream(file.Data()); // Opened fine the first time
+    }
+    Start();
+}
+
+void LevelStream::Start()
+{
+    next_spawn = 0;
+    x_done = 0.0f;
+    error = open_error;
+    ClearQueue(ready_chunks);
+    ClearQueue(free_chunks);
+    for (int i = 0; i < LEVEL_STREAM_CHUNKS; i++) {
+        PushChunk(free_chunks, i);
+    }
+    producer = std::jthread([this](std::stop_token stop) { Produce(stop); });
+}
+
+void LevelStream::Stop()
+{
+    if (!producer.joinable()) {
+        return;
+    }
+    producer.request_stop();
+    // Wakes the producer up if it waits for a free chunk
+    free_chunks.signal.fetch_add(1, std::memory_order_release);
+    free_chunks.signal.notify_one();
+    producer.join();
+}
+
+void LevelStream::Produce(std::stop_token stop)
+{
+    int ichunk = 0;
+    while (WaitChunk(free_chunks, ichunk, stop)) {
+        LevelChunk& chunk = chunks[ichunk];
+        chunk.spawns.clear();
+        chunk.last = false;
+        chunk.length = 0.0f;
+        if (source == Source::Compiled) {
+            FillCompiledChunk(chunk);
+        }
+        else if (source == Source::Midi) {
+            FillMidiChunk(chunk);
+        }
+        else {
+            chunk.last = true;
+        }
+        if (chunk.last) {
+            chunk.x_end = INFINITY;
+        }
+        x_done = chunk.x_end;
+        PushChunk(ready_chunks, ichunk);
+        if (chunk.last) {
+            return;
+        }
+    }
+}
+
+void LevelStream::FillCompiledChunk(LevelChunk& chunk)
+{
+    float x1 = x_done + LEVEL_CHUNK_WIDTH;
+    std::span<LevelSpawn const> spawns = level.spawns;
+    while (next_spawn < spawns.size() && spawns[next_spawn].x < x1 && chunk.spawns.size() < LEVEL_CHUNK_CAPACITY) {
+        chunk.spawns.push_back(spawns[next_spawn++]);
+    }
+    // A full chunk may stop in the middle of spawns sharing its last x
+    chunk.x_end = chunk.spawns.size() == LEVEL_CHUNK_CAPACITY ? chunk.spawns.back().x : x1;
+    chunk.last = next_spawn == spawns.size();
+    chunk.length = level.length;
+}
+
+// Same spawns as BuildLevel, in the same order. Tracks are decoded past the end of the chunk by
+// the longest note that still adds hp, so notes starting in the chunk get their final hp; notes
+// still held past that have reached SPAWN_HP_MAX anyway.
+void LevelStream::FillMidiChunk(LevelChunk& chunk)
+{
+    float x1 = x_done + LEVEL_CHUNK_WIDTH;
+    double horizon = x1 / PIXEL_PER_SECOND + (SPAWN_HP_MAX - 1) * SPAWN_HP_SUSTAIN_TIME + 1.0;
+    int step = midi.tickdiv > 0 ? midi.tickdiv * LEVEL_STREAM_STEP_BEATS : -(midi.tickdiv >> 8) * (midi.tickdiv & 0xff);
+    step = std::max(step, 1);
+    while (!MidiStreamEnded(midi) && TicksToSeconds(midi.tempo_map, midi.tickdiv, midi.ticks) < horizon) {
+        if (!ReadMidiStream(midi, midi.ticks + step)) {
+            error = std::format("{} at byte {}: {}", midi.error->reason, midi.error->offset, filepath);
+            chunk.last = true;
+            chunk.length = x_done;
+            return;
+        }
+    }
+    bool ended = MidiStreamEnded(midi);
+
+    // Merges the front notes of the tracks, ties go to the lowest track like BuildLevel
+    while (chunk.spawns.size() < LEVEL_CHUNK_CAPACITY) {
+        int itrack = -1;
+        for (int i = 0; i < midi.tracks.size(); i++) {
+            std::deque<Event> const& notes = midi.tracks[i].notes;
+            if (!notes.empty() && (itrack < 0 || notes.front().start_ticks < midi.tracks[itrack].notes.front().start_ticks)) {
+                itrack = i;
+            }
+        }
+        if (itrack < 0) {
+            break;
+        }
+        MidiStreamTrack& track = midi.tracks[itrack];
+        Event const& event = track.notes.front();
+        double start = TicksToSeconds(midi.tempo_map, midi.tickdiv, event.start_ticks);
+        if (float(start * PIXEL_PER_SECOND) >= x1) {
+            break;
+        }
+        LevelSpawn spawn;
+        int end_ticks = event.start_ticks + event.duration_ticks;
+        if (event.duration_ticks >= 0 && (ended || end_ticks <= midi.ticks)) {
+            spawn = MakeSpawn(event, itrack, start, TicksToSeconds(midi.tempo_map, midi.tickdiv, end_ticks));
+        }
+        else {
+            spawn = MakeSpawn(event, itrack, start, start + SPAWN_HP_MAX * SPAWN_HP_SUSTAIN_TIME);
+        }
+        chunk.spawns.push_back(spawn);
+        PopMidiStreamNote(track);
+    }
+
+    chunk.x_end = chunk.spawns.size() == LEVEL_CHUNK_CAPACITY ? chunk.spawns.back().x : x1;
+    chunk.last = ended && std::ranges::all_of(midi.tracks, [](MidiStreamTrack const& track) { return track.notes.empty(); });
+    if (chunk.last) {
+        int ticklen = 0;
+        for (MidiStreamTrack const& track : midi.tracks) {
+            if (track.end_ticks >= 0) {
+                ticklen = track.end_ticks;
+            }
+        }
+        chunk.length = float(TicksToSeconds(midi.tempo_map, midi.tickdiv, ticklen) * PIXEL_PER_SECOND);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "level.h"
+#include "mapped_file.h"
+#include "midi.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#define LEVEL_CHUNK_WIDTH 400.0f // Pixels of level covered by a chunk, half a screen
+#define LEVEL_CHUNK_CAPACITY 4096 // Spawns in a chunk at most, denser stretches take several chunks
+#define LEVEL_STREAM_CHUNKS 8 // Chunks decoded ahead of the simulation at most
+#define LEVEL_STREAM_STEP_BEATS 4 // MIDI is decoded this many beats at a time
+
+// A window of the spawn table, in order
+struct LevelChunk {
+    std::vector<LevelSpawn> spawns;
+    float x_end = 0.0f; // Every spawn before x_end is in this chunk or a previous one
+    bool last = false; // No chunk follows
+    float length = 0.0f; // Of the level, in pixels, set on the last chunk
+};
+
+// Single producer, single consumer queue of chunk indices. It can hold every chunk, so pushing
+// never fails.
+struct LevelChunkQueue {
+    std::array<int, LEVEL_STREAM_CHUNKS + 1> items;
+    std::atomic<size_t> head = 0; // Next item to pop, only moved by the consumer
+    std::atomic<size_t> tail = 0; // Next item to push, only moved by the producer
+    std::atomic<uint32_t> signal = 0; // Bumped by every push, to wait on
+};
+
+// Decodes a level on a background thread a few chunks ahead of the consumer, so it can start
+// before the whole file is read and memory stays bounded however long the level is.
+// Chunks are handed over through a pair of lock-free queues: ready ones to the consumer, and
+// released ones back to the producer to be filled again, so they keep their buffers.
+// Compiled levels are cut into chunks straight from the mapped file.
+class LevelStream {
+public:
+    // A level that can't be opened streams as empty, with Error set when the constructor returns.
+    // Errors further in the file end the stream early.
+    explicit LevelStream(std::string const& midi_filepath);
+    LevelStream(LevelStream const&) = delete;
+    LevelStream& operator=(LevelStream const&) = delete;
+    ~LevelStream();
+
+    // Blocks until the next chunk is ready, don't call again once the last one was received
+    LevelChunk const& Receive();
+    // Hands a received chunk back to be filled again
+    void Release(LevelChunk const& chunk);
+    // Starts over from the beginning of the level, chunks received so far must not be used anymore
+    void Restart();
+    // Why the stream ended early, empty otherwise. Only read after receiving the last chunk.
+    std::string const& Error() const { return error; }
+
+private:
+    void Open();
+    void Start();
+    void Stop();
+    void Produce(std::stop_token stop);
+    void FillCompiledChunk(LevelChunk& chunk);
+    void FillMidiChunk(LevelChunk& chunk);
+
+    enum class Source {
+        None, // Failed to open
+        Compiled,
+        Midi,
+    };
+
+    std::string filepath;
+    Source source = Source::None;
+    std::string open_error;
+    Level level; // Compiled levels only
+    MappedFile file; // MIDI levels only, midi views into it
+    MidiStream midi;
+
+    // Producer state, reset by Restart
+    size_t next_spawn = 0;
+    float x_done = 0.0f; // Spawns before it were all sent
+    std::string error;
+
+    std::array<LevelChunk, LEVEL_STREAM_CHUNKS> chunks;
+    LevelChunkQueue ready_chunks;
+    LevelChunkQueue free_chunks;
+    std::jthread producer; // Last, so it stops before the rest goes away
+};
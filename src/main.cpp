@@ -1,125 +1,135 @@
-#include "midi.h"
+#include "audio_clock.h"
+#include "bloom.h"
+#include "entity.h"
+#include "gpu_timers.h"
+#include "hud.h"
+#include "job_system.h"
+#include "level.h"
+#include "level_stream.h"
+#include "profiler.h"
 #include "raylib.h"
 #include "raymath.h"
-#include <filesystem>
-#include <fstream>
+#include "replay.h"
+#include "resolution_scaler.h"
+#include "shader_cache.h"
+#include "simulation.h"
+#include "sprite_batch.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <print>
 #include <string>
+#include <thread>
 #include <vector>
 
-#define PIXEL_PER_UNIT 100
-#define MAX_LEVEL_FILE_SIZE 100 * 1024 * 1024
-
-#define WARMUP_TIME_MAX 3.1f
-#define INVINCIBILITY_TIME_MAX 1.5f
-#define ENEMY_SHIELD_TIME_MAX 1.0f
-#define ENEMY_FIRE_TIME_MAX 2.0f
-#define ENEMY_DEFLECT_TIME_MAX 1.0f
-#define MULTIPLICATOR_MIN 1.0f
-#define TAIL_TIME_DEF 0.1f
-
-#define PLAYER_SIZE 30.0f
-#define ENEMY_SIZE 20.0f
-#define BULLET_SIZE_X 10.0f
-#define BULLET_SIZE_Y 5.0f
-#define DEFLECT_SIZE 30.0f
-
-#define ENEMY_SHIELD 2
-#define ENEMY_SHOOTER 3
-#define ENEMY_DEFLECT 4
-
-#define BULLET_FRIEND 0
-#define BULLET_FOE 1
-
-#define BULLET_FRIEND_SPEED 1000.0f 
-#define BULLET_FOE_SPEED 100.0f
-
-struct Entity {
-    bool alive;
-    bool can_move;
-    Vector2 pos;
-    Vector2 velocity;
-    int type;
-    int hp;
-    int hp_max;
-    float last_hit_time;
-    float last_fire_time;
-};
-
-struct Inputs {
-    Vector2 dir;
-    bool start;
-    bool pause;
-    bool fire;
-    bool reset;
-    float pan;
-    bool stop;
-    bool debug_overlay;
-    bool fullscreen;
-};
-
-struct Level {
-    float length;
-    std::vector<Entity> enemies;
-};
-
 Inputs GetInputs();
-Rectangle GetBoundingBox(float cx, float cy, float width, float height);
 void DrawRectangle(Rectangle rect, Color color);
-void DrawEntity(Entity const& entity, Vector2 size, Color color);
-void CreateBullet(std::vector<Entity>& bullets, Vector2 pos, Vector2 velocity, int type);
-
-int main(void) {
-    Level level;
-    try {
-        std::string working_dir = GetWorkingDirectory();
-        std::string filepath = "Assets/level0.mid";
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            throw std::runtime_error(std::format("Can't open level file: {}", filepath));
+void DrawProfilerOverlay(Profiler const& profiler, bool has_gpu_timers);
+void BatchEntity(SpriteBatch& batch, Entity const& entity, Vector2 size, Color color);
+void BatchEntity(SpriteBatch& batch, Vector2 pos, Vector2 size, Color color);
+
+int main(int argc, char** argv) {
+    std::string record_filepath;
+    std::string replay_filepath;
+    std::string profile_filepath; // Where the profiler frames are written on exit
+    int njobs = int(std::thread::hardware_concurrency()) - 1; // Workers besides the main thread
+    BloomQuality bloom_quality = BloomQuality::High;
+    bool use_shader_cache = true;
+    ResolutionScaleMode scale_mode = ResolutionScaleMode::Off;
+    float frame_budget = 0.0f; // Seconds, 0 for the refresh period of the monitor
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--no-shader-cache")) { // Compiles every shader from source
+            use_shader_cache = false;
+        }
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        if (!std::strcmp(argv[i], "--record")) {
+            record_filepath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--replay")) {
+            replay_filepath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--profile-dump")) {
+            profile_filepath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--jobs")) { // 0 runs everything on the main thread
+            njobs = std::atoi(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--bloom")) {
+            std::string name = argv[++i];
+            bloom_quality = name == "off" ? BloomQuality::Off : name == "low" ? BloomQuality::Low : BloomQuality::High;
         }
-        std::uintmax_t file_size = std::filesystem::file_size(filepath);
-        if (file_size > MAX_LEVEL_FILE_SIZE) {
-            throw std::runtime_error(std::format("Level file too big: {} ", filepath));
+        else if (!std::strcmp(argv[i], "--resolution-scale")) {
+            std::string name = argv[++i];
+            scale_mode = name == "all" ? ResolutionScaleMode::All : name == "post" ? ResolutionScaleMode::Post : ResolutionScaleMode::Off;
+        }
+        else if (!std::strcmp(argv[i], "--frame-budget")) { // In milliseconds
+            frame_budget = float(std::atof(argv[++i])) / 1000.0f;
+        }
+        else if (!std::strcmp(argv[i], "--min-scale")) {
+            min_scale = float(std::atof(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--max-scale")) {
+            max_scale = float(std::atof(argv[++i]));
+        }
+    }
+
+    // Decoded in the background while the game starts, the simulation pulls it as the camera moves
+    std::string level_filepath = "Assets/level0.mid";
+    LevelStream level_stream(level_filepath);
+    if (!level_stream.Error().empty()) {
+        std::println("{}", level_stream.Error());
+    }
+    // Replays need the whole spawn table to tell levels apart, only load it for them
+    uint64_t level_hash = 0;
+    if (!record_filepath.empty() || !replay_filepath.empty()) {
+        try {
+            level_hash = HashLevel(LoadLevel(level_filepath));
         }
-        std::vector<uint8_t> buffer(file_size);
-        if (!file.read(reinterpret_cast<char*>(buffer.data()), file_size)) {
-            throw std::runtime_error(std::format("Error reading file: {}", filepath));
+        catch(std::exception& e) {
+            std::println("{}", e.what());
+            level_hash = HashLevel(Level{});
         }
-        auto midi = LoadMidi(std::span<uint8_t const>(buffer));
-        for (int i = 0; i < midi.tracks.size(); i++) {
-            Track& track = midi.tracks[i];
-            for (int j = 0; j < track.events.size(); j++) {
-                Event& event = track.events[j];
-                Entity enemy;
-                enemy.pos.x = (float)event.start_ticks / midi.tickdiv;
-                enemy.pos.y = (float)event.note - MIDI_NOTE_DEF;
-                enemy.alive = false;
-                enemy.can_move = false;
-                enemy.type = i;
-                enemy.hp = 1;
-                enemy.hp_max = 1;
-                enemy.last_hit_time = 0.0f;
-                level.enemies.push_back(std::move(enemy));
+    }
+
+    // Replays feed the recorded inputs to the simulation steps, live inputs take over when it ends
+    Replay replay;
+    bool is_replaying = false;
+    if (!replay_filepath.empty()) {
+        try {
+            replay = LoadReplay(replay_filepath);
+            is_replaying = replay.header.level_hash == level_hash;
+            if (!is_replaying) {
+                std::println("Replay {} was recorded on another level", replay_filepath);
             }
         }
-        level.length = (float)midi.ticklen / midi.tickdiv;
-        std::println("Found {} enemies.", level.enemies.size());
-        for (auto& enemy : level.enemies) {
-            std::println("Enemy: ({},{}), {}", enemy.pos.x, enemy.pos.y, enemy.hp);
+        catch(std::exception& e) {
+            std::println("{}", e.what());
         }
     }
-    catch(std::exception& e) {
-        std::println("{}", e.what());
+    uint32_t seed = is_replaying ? replay.header.seed : uint32_t(std::time(nullptr));
+    ReplayRecorder recorder;
+    bool is_recording = !record_filepath.empty();
+    if (is_recording) {
+        BeginRecording(recorder, level_hash, seed);
     }
 
-    float game_width = 800;
-    float game_height = 450;
+    float game_width = SIM_GAME_WIDTH;
+    float game_height = SIM_GAME_HEIGHT;
     SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
     InitWindow(int(game_width), int(game_height), "ImomI");
     SetWindowMinSize(int(game_width), int(game_height));
+    SetRandomSeed(seed);
 
-    SetTargetFPS(60);
+    // Gameplay runs at SIM_TICK_RATE whatever the display does, so render as fast as it refreshes
+    int refresh_rate = GetMonitorRefreshRate(GetCurrentMonitor());
+    SetTargetFPS(refresh_rate);
+    if (frame_budget <= 0.0f) {
+        frame_budget = 1.0f / float(refresh_rate > 0 ? refresh_rate : 60);
+    }
 
     InitAudioDevice();
 
@@ -130,54 +140,53 @@ int main(void) {
     float screen_height = (float)GetScreenHeight();
     Vector2 game_resolution{game_width, game_height};
 
-    RenderTexture2D target = LoadRenderTexture((int)game_width, (int)game_height);
-    RenderTexture2D bufferA_target = LoadRenderTexture((int)game_width, (int)game_height);
-    RenderTexture2D bufferB_target = LoadRenderTexture((int)game_width, (int)game_height);
-    Shader threshold_shader = LoadShader(nullptr, "Assets/threshold.fs");
-    Shader blur_shader = LoadShader(nullptr, "Assets/blur.fs");
-    Shader crt_shader = LoadShader(nullptr, "Assets/crt.fs");
-    int blur_direction_loc = GetShaderLocation(blur_shader, "direction");
+    // Programs linked on an earlier launch are loaded as binaries instead of compiled again
+    ShaderCache shader_cache;
+    InitShaderCache(shader_cache, use_shader_cache ? SHADER_CACHE_DIRECTORY : "");
+
+    // Offscreen passes draw in game coordinates, on targets that may be smaller when the frames run over budget
+    ResolutionScaler scaler;
+    InitResolutionScaler(scaler, frame_budget, min_scale, scale_mode == ResolutionScaleMode::Off ? 1.0f : max_scale);
+    float scene_scale = scale_mode == ResolutionScaleMode::All ? scaler.scale : 1.0f;
+    RenderTexture2D target = LoadRenderTexture(GetScaledSize(game_width, scene_scale), GetScaledSize(game_height, scene_scale));
+    SetTextureFilter(target.texture, TEXTURE_FILTER_BILINEAR); // Drawn 1:1 except when downsampled for bloom
+    RenderTexture2D composite_target = LoadRenderTexture(GetScaledSize(game_width, scene_scale), GetScaledSize(game_height, scene_scale));
+    SetTextureFilter(composite_target.texture, TEXTURE_FILTER_BILINEAR); // Upscaled by the CRT pass
+    Hud hud; // Not scaled, text stays sharp
+    LoadHud(hud, (int)game_width, (int)game_height);
+    Bloom bloom;
+    LoadBloom(bloom, GetScaledSize(game_width, scaler.scale), GetScaledSize(game_height, scaler.scale), bloom_quality, shader_cache);
+    Shader crt_shader = LoadCachedShader(shader_cache, "Assets/crt.fs");
     int crt_resolution_loc = GetShaderLocation(crt_shader, "resolution");
     SetShaderValue(crt_shader, crt_resolution_loc, &game_resolution, SHADER_UNIFORM_VEC2);
 
-    PlayMusicStream(music);
-
-    Camera2D camera = {
-        .offset = { 0.0f, 0.0f },
-        .target = { -game_width, -game_height * 0.5f },
-        .rotation = 0.0f,
-        .zoom = 1.0f,
+    // CPU time of every phase, GPU time of the render ones where timer queries are available
+    Profiler profiler;
+    GpuTimers gpu_timers;
+    LoadGpuTimers(gpu_timers);
+    bool show_profiler = false;
+    auto begin_phase = [&](ProfilePhase phase) {
+        BeginProfilePhase(profiler, phase);
+        BeginGpuPhase(gpu_timers, phase);
     };
-
-    Entity player = {
-        .alive = true,
-        .can_move = true,
-        .pos = { -game_width * 0.5f, game_height * 0.15f },
-        .velocity = { 360.0f, 360.0f },
+    auto end_phase = [&](ProfilePhase phase) {
+        EndGpuPhase(gpu_timers);
+        EndProfilePhase(profiler, phase);
     };
 
-    std::vector<Entity> enemies = level.enemies;
-    std::vector<Vector2> spawn_pos(enemies.size());
-    for (int i = 0; i < spawn_pos.size(); i++) {
-        Vector2& pos = spawn_pos[i];
-        Entity& enemy = enemies[i];
-        pos.x = enemy.pos.x * PIXEL_PER_UNIT;
-        pos.y = enemy.pos.y * 0.1f * PIXEL_PER_UNIT;
-        enemy.alive = true;
-        enemy.can_move = false;
-        enemy.pos = pos;
-    }
+    PlayMusicStream(music);
 
-    std::vector<Entity> bullets(20);
-    for (int i = 0; i < bullets.size(); i++) {
-        Entity& entity = bullets[i];
-        entity.alive = false;
-        entity.pos = { 0.0f, -999.0f };
+    JobSystem jobs(std::max(njobs, 0));
+    Simulation sim(level_stream, game_width, game_height);
+    if (jobs.WorkerCount()) {
+        sim.jobs = &jobs;
     }
-
-    Vector2 tail[4]{player.pos};
-    int itail = 0;
-    float tail_time = TAIL_TIME_DEF;
+    sim.profiler = &profiler;
+    Inputs pending_inputs = {};
+    SpriteBatch sprites; // Entities of the world pass
+    float accumulator = 0.0f; // Frame time not consumed by a step yet
+    AudioClock audio_clock;
+    bool is_music_locked = false; // Steps follow audio_clock instead of the frame time
 
     struct {
         float x0;
@@ -191,447 +200,167 @@ int main(void) {
         { game_width * 0.85f, game_width * 0.85f, 20.0f, 1, 50.0f },
     };
     
-    bool just_booted = true;
-    bool is_paused = false;
-    bool show_debug_overlay = false;
-    bool level_end_reached = false;
-    bool start_new_level = false;
-    bool can_progress = false;
-    float cooldown_time = 0.4f;
-    int alive_entities = 0;
-    int active_entities = 0;
-    float invincibility_time = INVINCIBILITY_TIME_MAX;
-    float warmup_time = WARMUP_TIME_MAX;
-    int score = 0;
-    float multiplicator = MULTIPLICATOR_MIN;
-    float strike_time = 0.0f;
-
-    auto RestartLevel = [&]{
-        is_paused = false;
-        show_debug_overlay = false;
-        level_end_reached = false;
-        start_new_level = true;
-        can_progress = false;
-        cooldown_time = 0.4f;
-        alive_entities = 0;
-        active_entities = 0;
-        invincibility_time = INVINCIBILITY_TIME_MAX;
-        warmup_time = WARMUP_TIME_MAX;
-        score = 0;
-        multiplicator = MULTIPLICATOR_MIN;
-        strike_time = 0.0f;
-        player = {
-            .alive = true,
-            .can_move = false,
-            .pos = { -game_width * 0.75f, 0.0f },
-            .velocity = { 360.0f, 360.0f },
-        };
-        for (auto& enemy : enemies) {
-            enemy.alive = true;
-            enemy.can_move = false;
-            enemy.pos = { 0.0f, -999.0f};
-            enemy.hp = enemy.hp_max;
-            enemy.last_hit_time = 0.0f;
-        }
-        for (Entity& entity : bullets) {
-            entity.alive = false;
-            entity.pos = { 0.0f, -999.0f };
-        }
-        camera = {
-            .offset = { 0.0f, 0.0f },
-            .target = { -game_width - 0.5f * PIXEL_PER_UNIT, -game_height * 0.5f },
-            .rotation = 0.0f,
-            .zoom = 1.0f,
-        };
-    };
-
-    Vector2 target_start_cutscene = {};
-    Vector2 target_end_cutscene = {};
-    
-    float elapsed_time = 0.0f;
-    bool show_restart_help = false;
-    bool will_restart = false;
     while (!WindowShouldClose()) {
-        if (is_paused) {
-            SetMusicVolume(music, 0.2f);
-        }
-        else {
-            SetMusicVolume(music, 1.0f);
-        }
+        BeginProfileFrame(profiler);
+        BeginGpuFrame(gpu_timers, profiler);
+
         UpdateMusicStream(music);
         
+        BeginProfilePhase(profiler, ProfilePhase::Input);
         Inputs inputs = GetInputs();
+        EndProfilePhase(profiler, ProfilePhase::Input);
 
         if (inputs.fullscreen) {
             ToggleBorderlessWindowed();
         }
-        
-        if (inputs.pause) {
-            is_paused = !is_paused;
-            if (!is_paused) {
-                warmup_time = 3.0f;
-            }
+        if (IsKeyPressed(KEY_B)) { // A render setting, not a gameplay input: not replayed
+            ResizeBloom(bloom, bloom.width, bloom.height, GetNextBloomQuality(bloom.quality));
         }
-        if (inputs.debug_overlay) {
-            show_debug_overlay = !show_debug_overlay;
+        if (IsKeyPressed(KEY_F3)) {
+            show_profiler = !show_profiler;
         }
 
         float frame_time = GetFrameTime();
 
-        if (abs(camera.target.x) > level.length * PIXEL_PER_UNIT) {
-            level_end_reached = true;
-        }
-
-        if (just_booted) {
-            if (inputs.start) {
-                just_booted = false;
-                RestartLevel();
-            }
-            float progression = frame_time * 300.0f;
-            camera.target.x += progression;
-            player.pos.x += progression;
-            if (tail_time > 0.0f) {
-                tail_time -= frame_time;
-                if (tail_time <= 0.0f) {
-                    tail_time = TAIL_TIME_DEF;
-                    tail[itail] = player.pos;
-                    itail = (itail + 1) % 4;
-                }
+        if (scale_mode != ResolutionScaleMode::Off && UpdateResolutionScaler(scaler, frame_time)) {
+            if (scale_mode == ResolutionScaleMode::All) {
+                UnloadRenderTexture(target);
+                UnloadRenderTexture(composite_target);
+                target = LoadRenderTexture(GetScaledSize(game_width, scaler.scale), GetScaledSize(game_height, scaler.scale));
+                SetTextureFilter(target.texture, TEXTURE_FILTER_BILINEAR);
+                composite_target = LoadRenderTexture(GetScaledSize(game_width, scaler.scale), GetScaledSize(game_height, scaler.scale));
+                SetTextureFilter(composite_target.texture, TEXTURE_FILTER_BILINEAR);
             }
+            ResizeBloom(bloom, GetScaledSize(game_width, scaler.scale), GetScaledSize(game_height, scaler.scale), bloom.quality);
         }
-        else if (start_new_level) {
-            // Memo: I put statics here because quicker...
-            static float acceleration = 200.0f;
-            static float velocity = 0.0f;
-            static bool should_call_on_entry = true;
-            static auto on_entry = [&]() {
-                target_start_cutscene = { game_width * 0.5f, game_height * 0.5f };
-                target_end_cutscene = { game_width * 0.25f + 0.5f * PIXEL_PER_UNIT, game_height * 0.5f };
-                player.pos = target_start_cutscene + camera.target;
-            };
-
-            if (should_call_on_entry) {
-                on_entry();
-                should_call_on_entry = false;
-            }
 
-            static auto move_toward = [&](Vector2 target, float distance) {
-                if (!Vector2Equals(player.pos, target + camera.target)) {
-                    player.pos = Vector2MoveTowards(player.pos, target + camera.target, distance);
-                    return false;
-                }
-                return true;
-            };
-
-            velocity += acceleration * frame_time;
-            if (move_toward(target_end_cutscene, velocity * frame_time)) {
-                start_new_level = false;
-                should_call_on_entry = true;
-                velocity = 0.0f;
-                camera.target = { -game_width - 0.5f * PIXEL_PER_UNIT, -game_height * 0.5f };
-                player.pos = { -game_width * 0.75f, 0.0f };
+        AccumulateInputs(pending_inputs, inputs);
+        auto step = [&]() {
+            Inputs step_inputs = pending_inputs;
+            if (is_replaying) {
+                is_replaying = ReadReplayInputs(replay, step_inputs);
             }
-
-            float progression = frame_time * 300.0f;
-            camera.target.x += progression;
-            player.pos.x += progression;
-            if (tail_time > 0.0f) {
-                tail_time -= frame_time;
-                if (tail_time <= 0.0f) {
-                    tail_time = TAIL_TIME_DEF;
-                    tail[itail] = player.pos;
-                    itail = (itail + 1) % 4;
-                }
+            if (is_recording) {
+                RecordInputs(recorder, step_inputs);
             }
+            sim.Step(step_inputs);
+            ConsumeInputPresses(pending_inputs);
+        };
+        // While the level scrolls, it runs as many steps as the music has played: frame time lost to
+        // hitches is caught up instead of dropped, so the enemies stay on the beat. Pauses, cutscenes and
+        // rewinds run on the frame time with the music paused, so it is still about where the level is
+        // when it scrolls again, and is put back there.
+        bool was_music_locked = is_music_locked;
+        bool is_level_scrolling = sim.IsProgressing() && !pending_inputs.rewind;
+        if (!is_level_scrolling && IsMusicStreamPlaying(music)) {
+            PauseMusicStream(music);
         }
-        else if (level_end_reached) {
-            // Memo: I put statics here because quicker...
-            static bool in_place_for_cutscene = false;
-            static float acceleration = 300.0f;
-            static float velocity = 0.0f;
-            static bool should_call_on_entry = true;
-            static auto on_entry = [&]() {
-                target_start_cutscene = { game_width * 0.25f, game_height * 0.5f };
-                target_end_cutscene = { game_width * 0.75f, game_height * 0.5f };
-                strike_time = 0.3f;
-            };
-
-            if (should_call_on_entry) {
-                on_entry();
-                should_call_on_entry = false;
-            }
-
-            static auto move_toward = [&](Vector2 target, float distance) {
-                if (!Vector2Equals(player.pos, target + camera.target)) {
-                    player.pos = Vector2MoveTowards(player.pos, target + camera.target, distance);
-                    return false;
-                }
-                return true;
-            };
-            
-            if (strike_time > 0.0f) {
-                strike_time -= frame_time;
-                if (strike_time <= 0.0f) {
-                    strike_time = 0.0f;
-                }
-            }
-
-            player.can_move = false;
-            invincibility_time = 0.0f;
-
-            if (inputs.start) {
-                will_restart = true;
-                show_restart_help = false;
-            }
-
-            float progression = frame_time * 300.0f;
-            camera.target.x += progression;
-            player.pos.x += progression;
-            if (tail_time > 0.0f) {
-                tail_time -= frame_time;
-                if (tail_time <= 0.0f) {
-                    tail_time = TAIL_TIME_DEF;
-                    tail[itail] = player.pos;
-                    itail = (itail + 1) % 4;
-                }
-            }
-
-            if (!will_restart && !in_place_for_cutscene && move_toward(target_start_cutscene, 150.0f * frame_time)) {
-                in_place_for_cutscene = true;
-                show_restart_help = true;
-            }
-            else if (will_restart && in_place_for_cutscene) {
-                velocity += acceleration * frame_time;
-                if (move_toward(target_end_cutscene, velocity * frame_time)) {
-                    player.pos.y = -999.0f;
-                    in_place_for_cutscene = false;
-                    will_restart = false;
-                    should_call_on_entry = false;
-                    velocity = 0.0f;
-                    RestartLevel();
-                }
-            }
+        else if (is_level_scrolling && !IsMusicStreamPlaying(music)) {
+            ResumeMusicStream(music); // Does nothing once the music has stopped
         }
-        else if (!is_paused)
-        {
-            elapsed_time += frame_time;
-            Vector2 screen_center = { game_width * 0.5f, game_height * 0.5f };
-
-            if (inputs.reset) {
-                RestartLevel();
-            }
-
-            if (warmup_time > 0.0f) {
-                player.can_move = false;
-                warmup_time -= frame_time;
-                if (warmup_time < 0.0f) {
-                    warmup_time = 0.0f;
-                    can_progress = true;
-                    player.can_move = true;
-                }
-            }
-
-            if (cooldown_time > 0.0f && warmup_time <= 0.0f) {
-                cooldown_time -= frame_time;
-                if (cooldown_time <= 0.0f) {
-                    cooldown_time = 0.0f;
-                }
-            }
-
-            if (invincibility_time > 0.0f && warmup_time <= 0.0f) {
-                invincibility_time -= frame_time;
-                if (invincibility_time <= 0.0f) {
-                    invincibility_time = 0.0f;
-                }
-            }
-
-            if (strike_time > 0.0f && warmup_time <= 0.0f) {
-                strike_time -= frame_time;
-                if (strike_time <= 0.0f) {
-                    strike_time = 0.0f;
-                }
-            }
-
-            if (inputs.stop) {
-                can_progress = !can_progress;
-            }
-            
-            float progression = 0.0f;
-            if (can_progress && warmup_time <= 0.0f) {
-                progression = frame_time * 100.0f;
+        is_music_locked = is_level_scrolling && IsMusicStreamPlaying(music);
+        if (is_music_locked) {
+            if (!was_music_locked) {
+                ResyncAudioClock(audio_clock, music, double(sim.progress_ticks) * SIM_DT);
             }
-            progression = std::roundf(progression);
-
-            camera.offset.x += inputs.pan;
-            camera.target.x += progression;
-            
-            player.pos.x += progression;
-
-            if (player.can_move) {
-                player.pos.x += frame_time * player.velocity.x * inputs.dir.x;
-                player.pos.y += frame_time * player.velocity.y * inputs.dir.y;
-            }
-            player.pos.x = Clamp(player.pos.x, camera.target.x, camera.target.x + game_width);
-            player.pos.y = Clamp(player.pos.y, camera.target.y, camera.target.y + game_height);
-            
-            if (tail_time > 0.0f) {
-                tail_time -= frame_time;
-                if (tail_time <= 0.0f) {
-                    tail_time = TAIL_TIME_DEF;
-                    tail[itail] = player.pos;
-                    itail = (itail + 1) % 4;
-                }
+            else {
+                UpdateAudioClock(audio_clock, music, frame_time);
             }
-
-            for (int i = 0; i < 4; i++) {
-                tail[i].x += progression;
+            double music_ticks = audio_clock.time * SIM_TICK_RATE;
+            int max_steps = int(SIM_MAX_FRAME_TIME * SIM_TICK_RATE); // Far behind, it catches up over several frames
+            for (int i = 0; i < max_steps && double(sim.progress_ticks + 1) <= music_ticks && sim.IsProgressing(); i++) {
+                step();
             }
-
-            Rectangle player_rect = GetBoundingBox(player.pos.x, player.pos.y, PLAYER_SIZE, PLAYER_SIZE);
-
-            if (inputs.fire && cooldown_time <= 0.0f) {
-                cooldown_time = 0.12f;
-                CreateBullet(bullets, { player.pos.x + PLAYER_SIZE * 0.5f, player.pos.y }, { BULLET_FRIEND_SPEED, 0.0f }, BULLET_FRIEND);
-            }
-
-            alive_entities = 0;
-            active_entities = 0;
-            for (int i = 0; i < enemies.size(); i++) {
-                Entity& enemy = enemies[i];
-                if (!enemy.alive)
-                    continue;
-                alive_entities++;
-                if (!enemy.can_move) {
-                    Vector2& pos = spawn_pos[i];
-                    if (pos.x - ENEMY_SIZE * 0.5f >= camera.target.x + game_width)
-                        continue;
-                    enemy.can_move = true;
-                    enemy.pos = pos;
-                    enemy.last_fire_time = ENEMY_FIRE_TIME_MAX;
-                }
-                active_entities++;
-
-                if (enemy.pos.x <= camera.target.x) {
-                    enemy.can_move = false;
-                    active_entities--;
-                    continue;
-                }
-
-                Rectangle enemy_rect = GetBoundingBox(enemy.pos.x, enemy.pos.y, ENEMY_SIZE, ENEMY_SIZE);
-                if (invincibility_time <= 0.0f && CheckCollisionRecs(player_rect, enemy_rect)) {
-                    invincibility_time = INVINCIBILITY_TIME_MAX;
-                    player.hp--;
-                    multiplicator = MULTIPLICATOR_MIN;
-                    strike_time = 0.3f;
-                }
-
-                if (enemy.type == ENEMY_SHOOTER && elapsed_time - enemy.last_fire_time >= ENEMY_FIRE_TIME_MAX) {
-                    enemy.last_fire_time = elapsed_time;
-                    CreateBullet(bullets, { enemy.pos.x - ENEMY_SIZE * 0.5f, enemy.pos.y }, { -BULLET_FOE_SPEED, 0.0f }, BULLET_FOE);
-                }
-
-                for (int j = 0; j < bullets.size(); j++) {
-                    Entity& bullet = bullets[j];
-                    if (bullet.alive && bullet.type == BULLET_FRIEND) {
-                        Rectangle bullet_rect = GetBoundingBox(bullet.pos.x, bullet.pos.y, BULLET_SIZE_X, BULLET_SIZE_Y);
-                        if (CheckCollisionRecs(bullet_rect, enemy_rect)) {
-                            if (enemy.type == ENEMY_DEFLECT && elapsed_time - enemy.last_hit_time >= ENEMY_DEFLECT_TIME_MAX) {
-                                enemy.last_hit_time = elapsed_time;
-                                bullet.velocity.y = (bullet.pos.y - enemy.pos.y) * 2.0f;
-                                bullet.velocity.x = -BULLET_FOE_SPEED;
-                                bullet.type = BULLET_FOE;
-                            }
-                            else if (enemy.type == ENEMY_SHIELD && elapsed_time - enemy.last_hit_time >= ENEMY_SHIELD_TIME_MAX) {
-                                enemy.last_hit_time = elapsed_time;
-                                bullet.alive = false;
-                            }
-                            else {
-                                bullet.alive = false;
-                                enemy.hp--;
-                                if (enemy.hp <= 0) {
-                                    enemy.alive = false;
-                                    alive_entities--;
-                                    score += int(multiplicator * enemy.hp_max * 100);
-                                    multiplicator += 0.1f;
-                                    strike_time = 0.3f;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-
-            }
-
-            for (int i = 0; i < bullets.size(); i++) {
-                Entity& bullet = bullets[i];
-                if (bullet.alive) {
-                    bullet.pos.x += frame_time * bullet.velocity.x;
-                    bullet.pos.y += frame_time * bullet.velocity.y;
-                    if (bullet.pos.x - 5 >= camera.target.x + game_width || bullet.pos.x + 5 <= camera.target.x) {
-                        bullet.alive = false;
-                    }
-                    else if (bullet.type == BULLET_FOE) {
-                        Rectangle bullet_rect = GetBoundingBox(bullet.pos.x, bullet.pos.y, BULLET_SIZE_X, BULLET_SIZE_Y);
-                        if (invincibility_time <= 0.0f && CheckCollisionRecs(player_rect, bullet_rect)) {
-                            invincibility_time = INVINCIBILITY_TIME_MAX;
-                            player.hp--;
-                            multiplicator = MULTIPLICATOR_MIN;
-                            strike_time = 0.3f;
-                        }
-                    }
-                }
+            accumulator = float(std::clamp(music_ticks - double(sim.progress_ticks), 0.0, 1.0)) * SIM_DT;
+        }
+        else {
+            accumulator += std::min(frame_time, SIM_MAX_FRAME_TIME);
+            while (accumulator >= SIM_DT) {
+                step();
+                accumulator -= SIM_DT;
             }
-
-            
         }
 
-        BeginTextureMode(target);
+        // Draw where things are between the last two steps
+        float alpha = accumulator / SIM_DT;
+        Camera2D camera = sim.camera;
+        camera.target = Vector2Lerp(sim.previous_camera_target, sim.camera.target, alpha);
+        Entity player = sim.player;
+        player.pos = Vector2Lerp(sim.previous_player_pos, sim.player.pos, alpha);
+
+        ResetSpriteBatchCounters(sprites);
+        int enemies_drawn = 0;
+        int enemies_culled = 0;
+        int bullets_drawn = 0;
+        int bullets_culled = 0;
+        begin_phase(ProfilePhase::Scene);
+        BeginScaledTextureMode(target, game_width, game_height);
             ClearBackground(BLANK);
             BeginMode2D(camera);
-                if (just_booted) {
+                if (sim.just_booted) {
 
                 }
                 else {
-                    for (int i = 0; i < bullets.size(); i++) {
-                        Entity& bullet = bullets[i];
-                        Vector2 pos = GetWorldToScreen2D(bullet.pos, camera);
-                        if (pos.x + BULLET_SIZE_X * 0.5f <= 0 || pos.x - BULLET_SIZE_X * 0.5f >= game_width) {
+                    // World x range on screen, things fully outside aren't drawn
+                    float view_min_x = GetScreenToWorld2D({ 0.0f, 0.0f }, camera).x;
+                    float view_max_x = GetScreenToWorld2D({ game_width, 0.0f }, camera).x;
+                    EntityStore const& bullet_store = sim.bullets.store;
+                    float bullet_margin = BULLET_SIZE_X * 0.5f / camera.zoom;
+                    for (int slot : sim.bullets.alive_slots) {
+                        // Bullets move in straight lines: step back along the velocity instead of keeping previous positions
+                        Vector2 bullet_pos = {
+                            bullet_store.pos_x[slot] + bullet_store.vel_x[slot] * (alpha - 1.0f) * SIM_DT,
+                            bullet_store.pos_y[slot] + bullet_store.vel_y[slot] * (alpha - 1.0f) * SIM_DT,
+                        };
+                        if (bullet_pos.x <= view_min_x - bullet_margin || bullet_pos.x >= view_max_x + bullet_margin) {
+                            bullets_culled++;
                             continue;
                         }
-                        if (bullet.alive) {
-                            DrawEntity(bullet, { BULLET_SIZE_X, BULLET_SIZE_Y }, bullet.type == BULLET_FRIEND ? PINK : SKYBLUE);
+                        if (bullet_store.alive[slot]) {
+                            bullets_drawn++;
+                            BatchEntity(sprites, bullet_pos, { BULLET_SIZE_X, BULLET_SIZE_Y }, bullet_store.cold[slot].type == BULLET_FRIEND ? PINK : SKYBLUE);
                         }
-                        else if (show_debug_overlay) {
-                            Rectangle rect = GetBoundingBox(bullet.pos.x, bullet.pos.y, BULLET_SIZE_X, BULLET_SIZE_Y);
+                    }
+                    if (sim.show_debug_overlay) {
+                        FlushSpriteBatch(sprites); // Outlines go on top of what is batched so far
+                        for (int slot : sim.bullets.free_slots) {
+                            Vector2 bullet_pos = { bullet_store.pos_x[slot], bullet_store.pos_y[slot] };
+                            if (bullet_pos.x <= view_min_x - bullet_margin || bullet_pos.x >= view_max_x + bullet_margin) {
+                                continue;
+                            }
+                            Rectangle rect = GetBoundingBox(bullet_pos.x, bullet_pos.y, BULLET_SIZE_X, BULLET_SIZE_Y);
                             DrawRectangleLines((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, PURPLE);
                         }
                     }
-                    for (int i = 0; i < enemies.size(); i++) {
-                        Entity& enemy = enemies[i];
-                        Vector2 pos = GetWorldToScreen2D(enemy.pos, camera);
-                        if (pos.x + ENEMY_SIZE * 0.5f <= 0 || pos.x - ENEMY_SIZE * 0.5f >= game_width) {
-                            continue;
-                        }
+                    // Only visits the enemies on screen, found by a binary search over the spawns sorted by x
+                    float enemy_margin = ENEMY_SIZE * 0.5f / camera.zoom;
+                    auto [first_visible, last_visible] = sim.FindSpawnsBetween(view_min_x - enemy_margin, view_max_x + enemy_margin);
+                    last_visible = std::min(last_visible, sim.spawn_cursor); // Enemies past the cursor aren't set up yet
+                    first_visible = std::min(first_visible, last_visible);
+                    enemies_culled = int(sim.spawn_cursor - sim.spawn_base) - int(last_visible - first_visible);
+                    for (size_t i = first_visible; i < last_visible; i++) {
+                        Entity& enemy = sim.Enemy(i);
                         if (enemy.alive && enemy.can_move) { // Alive in bounds
+                            enemies_drawn++;
                             if (enemy.type == ENEMY_SHIELD) {
-                                float shield_time = (elapsed_time - enemy.last_hit_time) / ENEMY_SHIELD_TIME_MAX;
+                                float shield_time = (sim.elapsed_time - enemy.last_hit_time) / ENEMY_SHIELD_TIME_MAX;
                                 if (shield_time <= 1.0f) {
                                     float shield_size = shield_time * ENEMY_SIZE;
-                                    DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
-                                    DrawEntity(enemy, { shield_size , shield_size }, SKYBLUE);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
+                                    BatchEntity(sprites, enemy, { shield_size , shield_size }, SKYBLUE);
                                 }
                                 else {
-                                    DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, SKYBLUE);
-                                    DrawEntity(enemy, { ENEMY_SIZE - 4.0f , ENEMY_SIZE - 4.0f }, RED);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, SKYBLUE);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE - 4.0f , ENEMY_SIZE - 4.0f }, RED);
                                 }
                             }
                             else if (enemy.type == ENEMY_SHOOTER) {
-                                float fire_time = (elapsed_time - enemy.last_fire_time) / ENEMY_FIRE_TIME_MAX;
-                                DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, Color{ 196, 93, 37, 255 });
+                                float fire_time = (sim.elapsed_time - enemy.last_fire_time) / ENEMY_FIRE_TIME_MAX;
+                                BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, Color{ 196, 93, 37, 255 });
                                 if (fire_time <= 1.0f) {
                                     int cooldown_height = lroundf(fire_time * ENEMY_SIZE);
-                                    DrawRectangleGradientH(
+                                    BatchRectangleGradientH(
+                                        sprites,
                                         lroundf(enemy.pos.x - ENEMY_SIZE * 0.5f),
                                         lroundf(enemy.pos.y - cooldown_height * 0.5f),
                                         lroundf(ENEMY_SIZE * 0.25f),
@@ -642,182 +371,169 @@ int main(void) {
                                 }
                             }
                             else if (enemy.type == ENEMY_DEFLECT) {
-                                float deflect_time = (elapsed_time - enemy.last_hit_time) / ENEMY_DEFLECT_TIME_MAX;
+                                float deflect_time = (sim.elapsed_time - enemy.last_hit_time) / ENEMY_DEFLECT_TIME_MAX;
                                 if (deflect_time <= 1.0f) {
                                     float deflect_size = deflect_time * ENEMY_SIZE;
-                                    DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
-                                    DrawEntity(enemy, { deflect_size , deflect_size }, PINK);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
+                                    BatchEntity(sprites, enemy, { deflect_size , deflect_size }, PINK);
                                 }
                                 else {
-                                    DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, PINK);
-                                    DrawEntity(enemy, { ENEMY_SIZE - 4.0f , ENEMY_SIZE - 4.0f }, RED);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, PINK);
+                                    BatchEntity(sprites, enemy, { ENEMY_SIZE - 4.0f , ENEMY_SIZE - 4.0f }, RED);
                                 }
                             }
                             else {
-                                DrawEntity(enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
+                                BatchEntity(sprites, enemy, { ENEMY_SIZE , ENEMY_SIZE }, RED);
                             }
                         }
-                        else if (show_debug_overlay) {
-                            Color color;
-                            if (enemy.alive && !enemy.can_move) { // Alive OOB
-                                color = GREEN;
-                            }
-                            else if (!enemy.alive && enemy.can_move) { // Dead in bound
-                                color = ORANGE;
-                            }
-                            else if (!enemy.alive && enemy.can_move) { // Dead OOB
-                                color = RED;
+                        else {
+                            enemies_culled++; // Dead or out of bounds
+                            if (sim.show_debug_overlay) {
+                                Color color;
+                                if (enemy.alive && !enemy.can_move) { // Alive OOB
+                                    color = GREEN;
+                                }
+                                else if (!enemy.alive && enemy.can_move) { // Dead in bound
+                                    color = ORANGE;
+                                }
+                                else if (!enemy.alive && enemy.can_move) { // Dead OOB
+                                    color = RED;
+                                }
+                                Rectangle rect = GetBoundingBox(enemy.pos.x, enemy.pos.y, ENEMY_SIZE, ENEMY_SIZE);
+                                FlushSpriteBatch(sprites);
+                                DrawRectangleLines((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
                             }
-                            Rectangle rect = GetBoundingBox(enemy.pos.x, enemy.pos.y, ENEMY_SIZE, ENEMY_SIZE);
-                            DrawRectangleLines((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
                         }
                     }
-                    if (show_debug_overlay){
+                    if (sim.show_debug_overlay){
+                        FlushSpriteBatch(sprites);
                         DrawRectangle(Rectangle(camera.target.x, camera.target.y, game_width, game_height), RED);
                         DrawLine(0, (int)camera.target.y, 0, (int)(game_height + camera.target.y), WHITE);
-                        DrawLine(int(level.length * PIXEL_PER_UNIT), (int)camera.target.y, int(level.length * PIXEL_PER_UNIT), (int)(game_height + camera.target.y), WHITE);
+                        DrawLine(int(sim.level_length), (int)camera.target.y, int(sim.level_length), (int)(game_height + camera.target.y), WHITE);
                     }
                 }
                 for (int i = 0; i < 4; i++) {
-                    auto j = (i + itail) % 4;
+                    auto j = (i + sim.itail) % 4;
                     auto size = 14.0f + (i + 1) * 4.0f;
-                    Rectangle rect = GetBoundingBox(tail[j].x, tail[j].y, size, size);
-                    DrawRectangle((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, Color{255, 255, 255, 125});
+                    Rectangle rect = GetBoundingBox(sim.tail[j].x, sim.tail[j].y, size, size);
+                    BatchRectangle(sprites, (int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, Color{255, 255, 255, 125});
                 }
-                if (invincibility_time > 0.0f) {
+                if (sim.invincibility_time > 0.0f) {
                     auto blink_period = INVINCIBILITY_TIME_MAX / 5;
-                    float shield_size = invincibility_time / INVINCIBILITY_TIME_MAX * PLAYER_SIZE;
-                    auto blink_up = std::fmodf(invincibility_time, blink_period) < blink_period * 0.5f;
-                    DrawEntity(player, { PLAYER_SIZE , PLAYER_SIZE }, DARKGRAY);
-                    DrawEntity(player, { shield_size , shield_size }, blink_up ? DARKGRAY : GRAY);
+                    float shield_size = sim.invincibility_time / INVINCIBILITY_TIME_MAX * PLAYER_SIZE;
+                    auto blink_up = std::fmodf(sim.invincibility_time, blink_period) < blink_period * 0.5f;
+                    BatchEntity(sprites, player, { PLAYER_SIZE , PLAYER_SIZE }, DARKGRAY);
+                    BatchEntity(sprites, player, { shield_size , shield_size }, blink_up ? DARKGRAY : GRAY);
                 }
                 else {
-                    DrawEntity(player, { PLAYER_SIZE , PLAYER_SIZE }, GRAY);
+                    BatchEntity(sprites, player, { PLAYER_SIZE , PLAYER_SIZE }, GRAY);
                 }
+                FlushSpriteBatch(sprites);
             EndMode2D();
-            if (just_booted) {
-                std::string press_start = "PRESS START";
-                auto width = MeasureText(press_start.c_str(), 50);
-                DrawText(press_start.c_str(), int((game_width - width) * 0.5f), int((game_height - 50) * 0.5f), 50, WHITE);
+        EndTextureMode();
+        end_phase(ProfilePhase::Scene);
+
+        // Texts are formatted every frame but only drawn again when they change
+        begin_phase(ProfilePhase::Hud);
+        BeginHud(hud);
+        if (sim.just_booted) {
+            AddHudText(hud, HudAlign::Center, int(game_width) / 2, int((game_height - 50) * 0.5f), 50, WHITE, "PRESS START");
+        }
+        else {
+            if (sim.show_restart_help) {
+                AddHudText(hud, HudAlign::Center, int(game_width) / 2, int(game_height * 0.75f), 40, WHITE, "PRESS START TO RETRY");
+            }
+            // The color follows the displayed value, so it only changes with the text
+            float multiplicator = std::round(sim.multiplicator * 10.0f) / 10.0f;
+            Color multiplicator_color;
+            if (multiplicator < 4.0f) {
+                multiplicator_color = ColorLerp(WHITE, YELLOW, (multiplicator - 1.0f) / 3.0f);
             }
             else {
-                if (show_restart_help) {
-                    std::string retry_text = "PRESS START TO RETRY";
-                    auto width = MeasureText(retry_text.c_str(), 40);
-                    DrawText(retry_text.c_str(), int((game_width - width) * 0.5f), int(game_height * 0.75f), 40, WHITE);
+                multiplicator_color = ColorLerp(YELLOW, RED, (multiplicator - 4.0f) / 3.0f);
+            }
+            if (sim.level_end_reached && !sim.will_restart) {
+                int score_font_size = int(std::round(15 * (sim.strike_time / 0.3f) + 90));
+                AddHudText(hud, HudAlign::Center, int(game_width) / 2, int(game_height * 0.25f - score_font_size * 0.5f), score_font_size, WHITE, "{}", sim.score);
+                AddHudText(hud, HudAlign::After, 5, int(game_height * 0.25f), 30, multiplicator_color, "x{:.1f}", multiplicator);
+            }
+            else if (!sim.will_restart) {
+                AddHudText(hud, HudAlign::Left, 2, 0, 50, WHITE, "{}", sim.score);
+                int multi_font_size = int(std::round(10 * (sim.strike_time / 0.3f) + 30));
+                AddHudText(hud, HudAlign::Left, 2, 50, multi_font_size, multiplicator_color, "x{:.1f}", multiplicator);
+            }
+            if (sim.show_debug_overlay) {
+                int middle = int(game_width) / 2;
+                int bottom = int(game_height);
+                AddHudText(hud, HudAlign::Left, middle, 0, 20, WHITE, "cTime: {:.2f}", sim.cooldown_time);
+                AddHudText(hud, HudAlign::Left, middle, 20, 20, WHITE, "iTime: {:.2f}", sim.invincibility_time);
+                AddHudText(hud, HudAlign::Left, 0, 0, 20, WHITE, "Player: {:.2f},   {:.2f}", player.pos.x, player.pos.y);
+                AddHudText(hud, HudAlign::Left, 0, 20, 20, WHITE, "Offset: {:.2f},   {:.2f}", camera.offset.x, camera.offset.y);
+                AddHudText(hud, HudAlign::Left, 0, 40, 20, WHITE, "Target: {:.2f},   {:.2f}", camera.target.x, camera.target.y);
+                AddHudText(hud, HudAlign::Left, 0, 60, 20, WHITE, "Rotation: {:.2f}", camera.rotation);
+                AddHudText(hud, HudAlign::Left, 0, 80, 20, WHITE, "Zoom: {:.2f}", camera.zoom);
+                AddHudText(hud, HudAlign::Left, 0, bottom - 100, 20, WHITE, "Streamed: {}", sim.SpawnsReceived());
+                AddHudText(hud, HudAlign::Left, 0, bottom - 80, 20, WHITE, "Kept: {}", sim.spawns.size());
+                AddHudText(hud, HudAlign::Left, 0, bottom - 60, 20, WHITE, "Active: {}", sim.active_entities);
+                AddHudText(hud, HudAlign::Left, 0, bottom - 40, 20, WHITE, "Dead: {}", sim.kills);
+                AddHudText(hud, HudAlign::Left, 0, bottom - 20, 20, WHITE, "Pending: {}", sim.SpawnsReceived() - sim.spawn_cursor);
+                AddHudText(hud, HudAlign::Left, middle, bottom - 60, 20, WHITE, "Bullets: {}/{}", sim.bullets.alive_slots.size(), sim.bullets.store.alive.size());
+                AddHudText(hud, HudAlign::Left, middle, bottom - 40, 20, WHITE, "Peak: {}", sim.bullets.high_water);
+                AddHudText(hud, HudAlign::Left, middle, bottom - 20, 20, WHITE, "Dropped: {}", sim.bullets.drops);
+                AddHudText(hud, HudAlign::Left, middle, 40, 20, WHITE, "Bloom: {} (B)", GetBloomQualityName(bloom.quality));
+                AddHudText(hud, HudAlign::Left, middle, 60, 20, WHITE, "Scale: {:.1f}, {}x{}", scaler.scale, bloom.width, bloom.height);
+                if (is_music_locked) {
+                    AddHudText(hud, HudAlign::Left, middle, 80, 20, WHITE, "Music lead: {:+.1f} ms", (audio_clock.time - double(sim.progress_ticks) * SIM_DT) * 1000.0);
+                }
+                else {
+                    AddHudText(hud, HudAlign::Left, middle, 80, 20, WHITE, "Music: not locked");
+                }
+                AddHudText(hud, HudAlign::Left, middle, bottom - 80, 20, WHITE, "Quads: {} in {} batches", sprites.quads_drawn, sprites.flushes);
+                AddHudText(hud, HudAlign::Left, middle, bottom - 120, 20, WHITE, "Enemies drawn/culled: {}/{}", enemies_drawn, enemies_culled);
+                AddHudText(hud, HudAlign::Left, middle, bottom - 100, 20, WHITE, "Bullets drawn/culled: {}/{}", bullets_drawn, bullets_culled);
+            }
+            if (sim.warmup_time > 0.0f && !sim.start_new_level) {
+                auto rounded_time = (int)sim.warmup_time;
+                auto subtime = Wrap(sim.warmup_time, 0.0f, 1.0f);
+                auto font_size = int(std::round(20 * subtime + 50));
+                if (rounded_time) {
+                    AddHudText(hud, HudAlign::Center, int(game_width) / 2, int(game_height) / 4, font_size, WHITE, "{}", rounded_time);
                 }
-                if (will_restart) {
-                    auto distance_to_portal = target_end_cutscene.x - player.pos.x + camera.target.x;
+                else {
+                    AddHudText(hud, HudAlign::Center, int(game_width) / 2, int(game_height) / 4, font_size, WHITE, "GO");
+                }
+                AddHudText(hud, HudAlign::Center, int(game_width) / 2, int(game_height) / 4 - 30, 30, WHITE, "{:.2f}", subtime);
+            }
+        }
+        RenderHud(hud);
+
+        BeginScaledTextureMode(target, game_width, game_height);
+            if (!sim.just_booted) {
+                if (sim.will_restart) {
+                    auto distance_to_portal = sim.target_end_cutscene.x - player.pos.x + camera.target.x;
                     auto portal_half_width = 50.0f * (distance_to_portal ? 50.0f / distance_to_portal : 2 * game_width);
-                    auto portal_pos = target_end_cutscene.x + distance_to_portal;
+                    auto portal_pos = sim.target_end_cutscene.x + distance_to_portal;
                     DrawRectangleGradientH(int(portal_pos - portal_half_width), 0, int(portal_half_width), int(game_height), Color{255, 255, 255, 0}, WHITE);
                     DrawRectangleGradientH(int(portal_pos), 0, int(portal_half_width), int(game_height), WHITE, Color{255, 255, 255, 0});
                 }
-                if (start_new_level) {
-                    auto distance_to_portal = abs(target_start_cutscene.x - player.pos.x + camera.target.x);
+                if (sim.start_new_level) {
+                    auto distance_to_portal = abs(sim.target_start_cutscene.x - player.pos.x + camera.target.x);
                     auto portal_half_width = 50.0f * (distance_to_portal ? 50.0f / distance_to_portal : 2 * game_width);
-                    auto portal_pos = target_start_cutscene.x - 3 * distance_to_portal;
+                    auto portal_pos = sim.target_start_cutscene.x - 3 * distance_to_portal;
                     DrawRectangleGradientH(int(portal_pos - portal_half_width), 0, int(portal_half_width), int(game_height), Color{255, 255, 255, 0}, WHITE);
                     DrawRectangleGradientH(int(portal_pos), 0, int(portal_half_width), int(game_height), WHITE, Color{255, 255, 255, 0});
                 }
-                if (level_end_reached && !will_restart) {
-                    int score_font_size = int(std::round(15 * (strike_time / 0.3f) + 90));
-                    auto score_text = std::format("{}", score);
-                    auto score_width = MeasureText(score_text.c_str(), score_font_size);
-                    DrawText(score_text.c_str(), int((game_width - score_width) * 0.5f), int(game_height * 0.25f - score_font_size * 0.5f), score_font_size, WHITE);
-                    Color score_color;
-                    if (multiplicator < 4.0f) {
-                        score_color = ColorLerp(WHITE, YELLOW, (multiplicator - 1.0f) / 3.0f);
-                    }
-                    else {
-                        score_color = ColorLerp(YELLOW, RED, (multiplicator - 4.0f) / 3.0f);
-                    }
-                    DrawText(std::format("x{:.1f}", multiplicator).c_str(), int((game_width + score_width) * 0.5f) + 5, int(game_height * 0.25f), 30, score_color);
-                }
-                else if (!will_restart) {
-                    DrawText(std::format("{}", score).c_str(), 2, 0, 50, WHITE);
-                    int multi_font_size = int(std::round(10 * (strike_time / 0.3f) + 30));
-                    Color score_color;
-                    if (multiplicator < 4.0f) {
-                        score_color = ColorLerp(WHITE, YELLOW, (multiplicator - 1.0f) / 3.0f);
-                    }
-                    else {
-                        score_color = ColorLerp(YELLOW, RED, (multiplicator - 4.0f) / 3.0f);
-                    }
-                    DrawText(std::format("x{:.1f}", multiplicator).c_str(), 2, 50, multi_font_size, score_color);
-                }
-                if (show_debug_overlay) {
-                    DrawText(std::format("cTime: {:.2f}", cooldown_time).c_str(), (int)game_width / 2, 0, 20, WHITE);
-                    DrawText(std::format("iTime: {:.2f}", invincibility_time).c_str(), (int)game_width / 2, 20, 20, WHITE);
-                    DrawText(std::format("Player: {:.2f},   {:.2f}", player.pos.x, player.pos.y).c_str(), 0, 0, 20, WHITE);
-                    DrawText(std::format("Offset: {:.2f},   {:.2f}", camera.offset.x, camera.offset.y).c_str(), 0, 20, 20, WHITE);
-                    DrawText(std::format("Target: {:.2f},   {:.2f}", camera.target.x, camera.target.y).c_str(), 0, 40, 20, WHITE);
-                    DrawText(std::format("Rotation: {:.2f}", camera.rotation).c_str(), 0, 60, 20, WHITE);
-                    DrawText(std::format("Zoom: {:.2f}", camera.zoom).c_str(), 0, 80, 20, WHITE);
-                    DrawText(std::format("Alive: {}", alive_entities).c_str(), 0, (int)game_height - 80, 20, WHITE);
-                    DrawText(std::format("Active: {}", active_entities).c_str(), 0, (int)game_height - 60, 20, WHITE);
-                    DrawText(std::format("Dead: {}", enemies.size() - alive_entities).c_str(), 0, (int)game_height - 40, 20, WHITE);
-                    DrawText(std::format("Inactive: {}", alive_entities - active_entities).c_str(), 0, (int)game_height - 20, 20, WHITE);
-                }
-                if (warmup_time > 0.0f && !start_new_level) {
-                    auto rounded_time = (int)warmup_time;
-                    auto text = rounded_time ? std::to_string(rounded_time) : "GO";
-                    auto subtime = Wrap(warmup_time, 0.0f, 1.0f);
-                    auto font_size = int(std::round(20 * subtime + 50));
-                    int width = MeasureText(text.c_str(), font_size);
-                    DrawText(text.c_str(), ((int)game_width - width) / 2, (int)game_height / 4, font_size, WHITE);
-                    auto subtime_text = std::format("{:.2f}", subtime);
-                    width = MeasureText(subtime_text.c_str(), 30);
-                    DrawText(subtime_text.c_str(), ((int)game_width - width) / 2, (int)game_height / 4 - 30, 30, WHITE);
-                }
             }
+            DrawHud(hud, game_width, game_height);
         EndTextureMode();
+        end_phase(ProfilePhase::Hud);
 
-        BeginTextureMode(bufferA_target);
-            ClearBackground(BLANK);
-            BeginShaderMode(threshold_shader);
-                DrawTexturePro(
-                    target.texture,
-                    Rectangle{0, 0, game_width, -game_height},
-                    Rectangle{0, 0, game_width, game_height},
-                    Vector2{0.0f, 0.0f},
-                    0.0f,
-                    WHITE
-                );
-            EndShaderMode();
-        EndTextureMode();
-        
-        for (int i = 0; i < 5; i++) {
-            BeginTextureMode(bufferB_target);
-                BeginShaderMode(blur_shader);
-                    Vector2 blur_direction{1.5f / game_width, 0.0f};
-                    SetShaderValue(blur_shader, blur_direction_loc, &blur_direction, SHADER_UNIFORM_VEC2);
-                    DrawTexturePro(
-                        bufferA_target.texture,
-                        Rectangle{0, 0, game_width, -game_height},
-                        Rectangle{0, 0, game_width, game_height},
-                        Vector2{0.0f, 0.0f},
-                        0.0f,
-                        WHITE
-                    );
-                EndShaderMode();
-            EndTextureMode();
-
-            BeginTextureMode(bufferA_target);
-                BeginShaderMode(blur_shader);
-                    blur_direction = {0.0f, 1.5f / game_height};
-                    SetShaderValue(blur_shader, blur_direction_loc, &blur_direction, SHADER_UNIFORM_VEC2);
-                    DrawTexturePro(
-                        bufferB_target.texture,
-                        Rectangle{0, 0, game_width, -game_height},
-                        Rectangle{0, 0, game_width, game_height},
-                        Vector2{0.0f, 0.0f},
-                        0.0f,
-                        WHITE
-                    );
-                EndShaderMode();
-            EndTextureMode();
-        }
+        begin_phase(ProfilePhase::Threshold);
+        ThresholdBloom(bloom, target.texture);
+        end_phase(ProfilePhase::Threshold);
+        begin_phase(ProfilePhase::Blur);
+        Texture2D const* bloom_texture = BlurBloom(bloom);
+        end_phase(ProfilePhase::Blur);
 
         for (int i = 0; i < 3; i++) {
             auto& marker = bkg_markers[i];
@@ -830,52 +546,61 @@ int main(void) {
             }
         }
 
-        BeginTextureMode(bufferB_target);
+        begin_phase(ProfilePhase::Composite);
+        BeginScaledTextureMode(composite_target, game_width, game_height);
             ClearBackground(BLANK);
             DrawRectangleGradientH(0, 0, int(bkg_markers[0].x), int(game_height), DARKPURPLE, BLACK);
             DrawRectangleGradientH(int(bkg_markers[0].x), 0, int(bkg_markers[1].x - bkg_markers[0].x + 1), int(game_height), BLACK, DARKPURPLE);
             DrawRectangle(int(bkg_markers[1].x), 0, int(bkg_markers[2].x - bkg_markers[1].x + 1), int(game_height), DARKPURPLE);
             DrawRectangleGradientH(int(bkg_markers[2].x), 0, int(game_width - bkg_markers[2].x + 1), int(game_height), DARKPURPLE, PURPLE);
-            if (show_debug_overlay) {
+            if (sim.show_debug_overlay) {
                 DrawLine(int(bkg_markers[0].x), 0, int(bkg_markers[0].x), int(game_height), PINK);
                 DrawLine(int(bkg_markers[1].x), 0, int(bkg_markers[1].x), int(game_height), PINK);
                 DrawLine(int(bkg_markers[2].x), 0, int(bkg_markers[2].x), int(game_height), PINK);
             }
             DrawTexturePro(
                 target.texture,
-                Rectangle{0, 0, game_width, -game_height},
+                Rectangle{0, 0, float(target.texture.width), -float(target.texture.height)},
                 Rectangle{0, 0, game_width, game_height},
                 Vector2{0.0f, 0.0f},
                 0.0f,
                 WHITE
             );
-            BeginBlendMode(BLEND_ADDITIVE);
-                DrawTexturePro(
-                    bufferA_target.texture,
-                    Rectangle{0, 0, game_width, -game_height},
-                    Rectangle{0, 0, game_width, game_height},
-                    Vector2{0.0f, 0.0f},
-                    0.0f,
-                    WHITE
-                );
-            EndBlendMode();
+            if (bloom_texture) {
+                BeginBlendMode(BLEND_ADDITIVE);
+                    DrawTexturePro(
+                        *bloom_texture,
+                        Rectangle{0, 0, float(bloom_texture->width), -float(bloom_texture->height)},
+                        Rectangle{0, 0, game_width, game_height},
+                        Vector2{0.0f, 0.0f},
+                        0.0f,
+                        WHITE
+                    );
+                EndBlendMode();
+            }
 
-            if (is_paused && !level_end_reached && !start_new_level) {
+            if (sim.is_paused && !sim.level_end_reached && !sim.start_new_level) {
                 DrawRectangle(0, 0, (int)game_width, (int)game_height, Color{0, 0, 0, 125});
                 int width = MeasureText("Pause", 24);
                 DrawText("Pause", ((int)game_width - width) / 2, ((int)game_height - 12) / 2, 25, WHITE);
             }
 
+            if (show_profiler) {
+                DrawProfilerOverlay(profiler, gpu_timers.is_supported);
+            }
+
             DrawFPS((int)game_width - 100, (int)game_height - 50);
         EndTextureMode();
+        end_phase(ProfilePhase::Composite);
 
         float scale = std::min((float)GetScreenWidth() / game_width, (float)GetScreenHeight() / game_height);
         BeginDrawing();
+            begin_phase(ProfilePhase::Crt);
             ClearBackground(BLACK);
             BeginShaderMode(crt_shader);
                 DrawTexturePro(
-                    bufferB_target.texture,
-                    Rectangle{0, 0, game_width, -game_height},
+                    composite_target.texture,
+                    Rectangle{0, 0, float(composite_target.texture.width), -float(composite_target.texture.height)},
                     Rectangle{
                         (GetScreenWidth() - (game_width * scale)) * 0.5f,
                         (GetScreenHeight() - (game_height * scale)) * 0.5f,
@@ -887,15 +612,38 @@ int main(void) {
                     WHITE
                 );
             EndShaderMode();
+            end_phase(ProfilePhase::Crt);
+        BeginProfilePhase(profiler, ProfilePhase::Present);
         EndDrawing();
+        EndProfilePhase(profiler, ProfilePhase::Present);
+    }
+
+    if (is_recording) {
+        try {
+            SaveReplay(recorder, record_filepath);
+            std::println("Saved {} ticks of inputs to {}", recorder.header.nticks, record_filepath);
+        }
+        catch(std::exception& e) {
+            std::println("{}", e.what());
+        }
+    }
+    if (!profile_filepath.empty()) {
+        try {
+            SaveProfile(profiler, profile_filepath);
+            std::println("Saved the last {} frames of profile to {}", std::min(profiler.nframes, size_t(PROFILER_FRAMES)) - 1, profile_filepath);
+        }
+        catch(std::exception& e) {
+            std::println("{}", e.what());
+        }
     }
 
     UnloadMusicStream(music);
     UnloadRenderTexture(target);
-    UnloadRenderTexture(bufferA_target);
-    UnloadRenderTexture(bufferB_target);
-    UnloadShader(threshold_shader);
-    UnloadShader(blur_shader);
+    UnloadRenderTexture(composite_target);
+    UnloadBloom(bloom);
+    UnloadHud(hud);
+    UnloadGpuTimers(gpu_timers);
+    UnloadShader(crt_shader);
 
     CloseAudioDevice();
 
@@ -904,36 +652,63 @@ int main(void) {
     return 0;
 }
 
-Rectangle GetBoundingBox(float cx, float cy, float width, float height)
+void DrawRectangle(Rectangle rect, Color color)
 {
-    float x = cx - width * 0.5f;
-    float y = cy - height * 0.5f;
-    return Rectangle{x, y, width, height};
+    DrawRectangleLines((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
 }
 
-void DrawRectangle(Rectangle rect, Color color)
+// One row per phase: p50 and p99 of the last frames, and the graph of the most recent ones.
+// Each graph is scaled to twice the p99 of its phase, the bars over it are cut and red.
+void DrawProfilerOverlay(Profiler const& profiler, bool has_gpu_timers)
 {
-    DrawRectangleLines((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
+    int const row_height = 18;
+    int const graph_frames = 256;
+    int const graph_x = 500;
+    int x = 10;
+    int y = 10;
+    char text[64];
+    DrawRectangle(x, y, graph_x + graph_frames + 10 - x, row_height * (int(ProfilePhase::Count) + 1) + 4, Color{ 0, 0, 0, 190 });
+    DrawText("ms p50/p99", x + 90, y + 4, 10, LIGHTGRAY);
+    DrawText(has_gpu_timers ? "gpu ms p50/p99" : "no gpu timers", x + 260, y + 4, 10, LIGHTGRAY);
+    for (int phase = 0; phase < int(ProfilePhase::Count); phase++) {
+        int row_y = y + row_height * (phase + 1);
+        ProfileStats cpu = GetProfileStats(profiler, ProfilePhase(phase), false);
+        ProfileStats gpu = GetProfileStats(profiler, ProfilePhase(phase), true);
+        DrawText(GetProfilePhaseName(ProfilePhase(phase)), x + 4, row_y + 4, 10, WHITE);
+        *std::format_to_n(text, sizeof(text) - 1, "{:.3f} / {:.3f}", cpu.p50, cpu.p99).out = '\0';
+        DrawText(text, x + 90, row_y + 4, 10, SKYBLUE);
+        if (gpu.nsamples) {
+            *std::format_to_n(text, sizeof(text) - 1, "{:.3f} / {:.3f}", gpu.p50, gpu.p99).out = '\0';
+            DrawText(text, x + 260, row_y + 4, 10, ORANGE);
+        }
+
+        float scale_ms = std::max({ cpu.p99, gpu.p99, 0.01f }) * 2.0f;
+        int graph_height = row_height - 2;
+        size_t nframes = std::min({ profiler.nframes - 1, size_t(graph_frames), size_t(PROFILER_FRAMES - 1) });
+        for (size_t i = 0; i < nframes; i++) {
+            ProfileFrame const& frame = profiler.frames[(profiler.nframes - 1 - nframes + i) % PROFILER_FRAMES];
+            int bar_x = graph_x + int(i);
+            float cpu_ms = frame.cpu_ms[phase];
+            int bar_height = std::min(int(cpu_ms / scale_ms * graph_height), graph_height);
+            DrawRectangle(bar_x, row_y + row_height - 1 - bar_height, 1, bar_height, cpu_ms > scale_ms ? RED : SKYBLUE);
+            float gpu_ms = frame.gpu_ms[phase];
+            if (gpu_ms >= 0.0f) {
+                int gpu_height = std::min(int(gpu_ms / scale_ms * graph_height), graph_height);
+                DrawRectangle(bar_x, row_y + row_height - 1 - gpu_height, 1, 1, gpu_ms > scale_ms ? RED : ORANGE);
+            }
+        }
+    }
 }
 
-void DrawEntity(Entity const& entity, Vector2 size, Color color)
+void BatchEntity(SpriteBatch& batch, Entity const& entity, Vector2 size, Color color)
 {
-    Rectangle rect = GetBoundingBox(entity.pos.x, entity.pos.y, size.x, size.y);
-    DrawRectangle((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
+    BatchEntity(batch, entity.pos, size, color);
 }
 
-void CreateBullet(std::vector<Entity>& bullets, Vector2 pos, Vector2 velocity, int type)
+void BatchEntity(SpriteBatch& batch, Vector2 pos, Vector2 size, Color color)
 {
-    for (int i = 0; i < bullets.size(); i++) {
-        Entity& bullet = bullets[i];
-        if (!bullet.alive) {
-            bullet.alive = true;
-            bullet.pos = pos;
-            bullet.velocity = velocity;
-            bullet.type = type;
-            break;
-        }
-    }
+    Rectangle rect = GetBoundingBox(pos.x, pos.y, size.x, size.y);
+    BatchRectangle(batch, (int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height, color);
 }
 
 Vector2 GetInputDir()
@@ -968,6 +743,7 @@ Inputs GetInputs()
     inputs.start = IsKeyPressed(KEY_SPACE);
     inputs.pause = IsKeyPressed(KEY_P);
     inputs.fire = IsKeyDown(KEY_SPACE);
+    inputs.rewind = IsKeyDown(KEY_BACKSPACE);
     inputs.reset = IsKeyPressed(KEY_R);
     inputs.stop = IsKeyPressed(KEY_I);
     inputs.fullscreen = IsKeyPressed(KEY_F5) || (IsKeyDown(KEY_LEFT_ALT) && IsKeyPressed(KEY_ENTER));
@@ -981,6 +757,7 @@ Inputs GetInputs()
         inputs.start |= IsGamepadButtonPressed(0, GAMEPAD_BUTTON_MIDDLE_RIGHT);
         inputs.pause |= IsGamepadButtonPressed(0, GAMEPAD_BUTTON_MIDDLE_RIGHT);
         inputs.fire |= IsGamepadButtonDown(0, GAMEPAD_BUTTON_RIGHT_FACE_RIGHT);
+        inputs.rewind |= IsGamepadButtonDown(0, GAMEPAD_BUTTON_LEFT_TRIGGER_1);
         inputs.reset |= IsGamepadButtonPressed(0, GAMEPAD_BUTTON_RIGHT_FACE_UP);
         inputs.stop |= IsGamepadButtonPressed(0, GAMEPAD_BUTTON_LEFT_FACE_DOWN);
         inputs.debug_overlay |= IsGamepadButtonPressed(0, GAMEPAD_BUTTON_MIDDLE_LEFT);
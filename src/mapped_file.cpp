@@ -0,0 +1,124 @@
+#include "mapped_file.h"
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const& filepath)
+{
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(std::format("Can't open file: {}", filepath));
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::runtime_error(std::format("Can't get file size: {}", filepath));
+    }
+    file_handle = file;
+    size = size_t(file_size.QuadPart);
+    if (size == 0) { // Empty files can't be mapped
+        return;
+    }
+    mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle) {
+        Unmap();
+        throw std::runtime_error(std::format("Can't map file: {}", filepath));
+    }
+    data = static_cast<uint8_t const*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        Unmap();
+        throw std::runtime_error(std::format("Can't map file: {}", filepath));
+    }
+}
+
+void MappedFile::Unmap()
+{
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        CloseHandle(file_handle);
+    }
+    data = nullptr;
+    size = 0;
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(std::string const& filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(std::format("Can't open file: {}", filepath));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error(std::format("Can't get file size: {}", filepath));
+    }
+    if (st.st_size == 0) { // Empty files can't be mapped
+        close(fd);
+        return;
+    }
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::format("Can't map file: {}", filepath));
+    }
+    madvise(mapping, size_t(st.st_size), MADV_SEQUENTIAL);
+    data = static_cast<uint8_t const*>(mapping);
+    size = size_t(st.st_size);
+}
+
+void MappedFile::Unmap()
+{
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        Unmap();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
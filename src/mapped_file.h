@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read-only view of a whole file, mapped in memory for as long as the object lives.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(std::string const& filepath);
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile();
+
+    std::span<uint8_t const> Data() const { return { data, size }; }
+    size_t Size() const { return size; }
+
+private:
+    void Unmap();
+
+    uint8_t const* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
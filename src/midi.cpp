@@ -1,139 +1,618 @@
 #include "midi.h"
-#include <istream>
+#include <algorithm>
+#include <atomic>
 #include <format>
+#include <optional>
 #include <span>
+#include <stdexcept>
+#include <thread>
 
+// Below this size, spawning decoder threads costs more than it saves
+#define MIDI_PARALLEL_MIN_SIZE 256 * 1024
 
-#define EXPECTS_ENOUGH_DATA(required_size, data_size, position)\
-if (position > data_size || required_size > data_size - position) {\
-    size_t actual_size = position >= data_size ? 0 : data_size - position;\
-    throw std::runtime_error(std::format("Not enough data! Expected {}, got {}", required_size, actual_size));\
+// Cursor over MIDI bytes. The first failure is kept and moves the cursor to the end,
+// so decoding loops stop on their own and later reads return zeros.
+struct MidiReader {
+    std::span<uint8_t const> data;
+    size_t pos = 0;
+    std::optional<MidiError> error;
+};
+
+void Fail(MidiReader& reader, std::string reason)
+{
+    if (!reader.error) {
+        reader.error = MidiError{ reader.pos, std::move(reason) };
+    }
+    reader.pos = reader.data.size();
 }
 
-#define EXPECTS_EQUAL(expected, actual)\
-if (expected != expected) {\
-    throw std::runtime_error(std::format("Expected '{}', got '{}'", expected, actual));\
+#define EXPECTS_ENOUGH_DATA(reader, required_size)\
+if (reader.pos > reader.data.size() || required_size > reader.data.size() - reader.pos) {\
+    size_t actual_size = reader.pos >= reader.data.size() ? 0 : reader.data.size() - reader.pos;\
+    Fail(reader, std::format("Not enough data! Expected {}, got {}", required_size, actual_size));\
+    return {};\
 }
 
-std::string ReadString(std::span<uint8_t const> data, size_t& pos, int nbytes) {
-    EXPECTS_ENOUGH_DATA(nbytes, data.size(), pos)
-    std::string buffer(reinterpret_cast<char const*>(data.data() + pos), nbytes);
-    pos += nbytes;
+// Returns a view into the source data, no copy
+std::string_view ReadString(MidiReader& reader, size_t nbytes) {
+    EXPECTS_ENOUGH_DATA(reader, nbytes)
+    std::string_view buffer(reinterpret_cast<char const*>(reader.data.data() + reader.pos), nbytes);
+    reader.pos += nbytes;
     return buffer;
 }
 
-uint32_t ReadUint32(std::span<uint8_t const> data, size_t& pos) {
-    EXPECTS_ENOUGH_DATA(4, data.size(), pos)
-    uint32_t value = (uint32_t(data[pos]) << 24) |
-                     (uint32_t(data[pos + 1]) << 16) |
-                     (uint32_t(data[pos + 2]) << 8) |
-                     (uint32_t(data[pos + 3]));
-    pos += 4;
+uint32_t ReadUint32(MidiReader& reader) {
+    EXPECTS_ENOUGH_DATA(reader, 4)
+    auto data = reader.data.subspan(reader.pos, 4);
+    uint32_t value = (uint32_t(data[0]) << 24) |
+                     (uint32_t(data[1]) << 16) |
+                     (uint32_t(data[2]) << 8) |
+                     (uint32_t(data[3]));
+    reader.pos += 4;
     return value;
 }
 
-uint16_t ReadUint16(std::span<uint8_t const> data, size_t& pos) {
-    EXPECTS_ENOUGH_DATA(2, data.size(), pos)
-    uint16_t value = (uint16_t(data[pos]) << 8) | uint16_t(data[pos + 1]);
-    pos += 2;
+uint16_t ReadUint16(MidiReader& reader) {
+    EXPECTS_ENOUGH_DATA(reader, 2)
+    auto data = reader.data.subspan(reader.pos, 2);
+    uint16_t value = (uint16_t(data[0]) << 8) | uint16_t(data[1]);
+    reader.pos += 2;
     return value;
 }
 
-uint8_t ReadUint8(std::span<uint8_t const> data, size_t& pos) {
-    EXPECTS_ENOUGH_DATA(1, data.size(), pos)
-    uint8_t value = data[pos];
-    pos += 1;
+uint8_t ReadUint8(MidiReader& reader) {
+    EXPECTS_ENOUGH_DATA(reader, 1)
+    uint8_t value = reader.data[reader.pos];
+    reader.pos += 1;
     return value;
 }
 
-uint32_t ReadVariableLengthQuantity(std::span<uint8_t const> data, size_t& pos) {
+uint32_t ReadVariableLengthQuantity(MidiReader& reader) {
     uint32_t value = 0;
     uint8_t byte = 0;
     int nread = 0;
     do {
-        byte = ReadUint8(data, pos);
-        value = (value << 7) | (byte & 0x7f);
-        if (nread) {
-            throw std::runtime_error("Variable length quantity should be max 4 bytes.");
+        if (nread == 4) {
+            Fail(reader, "Variable length quantity should be max 4 bytes.");
+            return {};
         }
+        byte = ReadUint8(reader);
+        value = (value << 7) | (byte & 0x7f);
+        nread++;
     } while (byte & 0x80);
     return value;
 }
 
-Midi LoadMidi(std::span<uint8_t const> data)
+bool Skip(MidiReader& reader, size_t nbytes) {
+    EXPECTS_ENOUGH_DATA(reader, nbytes)
+    reader.pos += nbytes;
+    return true;
+}
+
+struct TrackChunk {
+    size_t offset;
+    uint32_t length;
+};
+
+// Per track results that are merged across tracks once all of them are decoded
+struct TrackInfo {
+    size_t nevents = 0;
+    std::string_view name;
+    int end_ticks = -1; // No End of Track event
+    std::vector<Tempo> tempos;
+    std::vector<TimeSignature> time_signatures;
+};
+
+enum class TrackEventType {
+    Other, // Skipped
+    NoteOn,
+    NoteOff, // Also Note On with velocity 0
+    Name,
+    EndOfTrack,
+    Tempo,
+    TimeSignature,
+};
+
+// The parts of a track event that levels use
+struct TrackEvent {
+    TrackEventType type = TrackEventType::Other;
+    uint8_t channel = 0;
+    uint8_t note = 0;
+    uint8_t velocity = 0;
+    std::string_view name;
+    uint32_t usec_per_quarter = 0;
+    TimeSignature time_signature = {};
+};
+
+// Reads the event at the cursor, ticks and running status carry over from one call to the next.
+// With skip_meta, meta events are skipped without decoding them. Either way the same bytes are consumed.
+TrackEvent ReadTrackEvent(MidiReader& reader, int& ticks, uint8_t& current_status, bool skip_meta)
 {
-    Midi midi;
-    size_t pos = 0;
-    std::string identifier = ReadString(data, pos, 4);
-    EXPECTS_EQUAL(std::string("MThd"), identifier)
-    uint32_t chunklen = ReadUint32(data, pos);
-    midi.format = ReadUint16(data, pos);
-    midi.ntracks = ReadUint16(data, pos);
-    midi.tickdiv = ReadUint16(data, pos);
+    TrackEvent event;
+    uint32_t delta_time = ReadVariableLengthQuantity(reader);
+    ticks += delta_time;
+    uint8_t status = ReadUint8(reader);
+    if (status < 0x80) { // Running status
+        if (current_status < 0x80) {
+            reader.pos--;
+            Fail(reader, std::format("Data byte {:#04x} without a running status", status));
+            return event;
+        }
+        status = current_status;
+        reader.pos--; // Unread byte
+    } else {
+        current_status = status;
+    }
+    if (status == 0xff) { // Meta event
+        uint8_t msg = ReadUint8(reader);
+        uint32_t length = ReadVariableLengthQuantity(reader);
+        if (skip_meta) {
+            Skip(reader, length);
+        }
+        else if (msg == 0x03) { // Sequence/Track name
+            event.type = TrackEventType::Name;
+            event.name = ReadString(reader, length);
+        }
+        else if (msg == 0x2f) {
+            event.type = TrackEventType::EndOfTrack;
+            Skip(reader, length); // Empty in valid files
+        }
+        else if (msg == 0x51 && length == 3) { // Set tempo
+            event.type = TrackEventType::Tempo;
+            event.usec_per_quarter = uint32_t(ReadUint8(reader)) << 16;
+            event.usec_per_quarter |= uint32_t(ReadUint8(reader)) << 8;
+            event.usec_per_quarter |= uint32_t(ReadUint8(reader));
+        }
+        else if (msg == 0x58 && length == 4) { // Time signature
+            event.type = TrackEventType::TimeSignature;
+            TimeSignature& signature = event.time_signature;
+            signature.ticks = ticks;
+            signature.numerator = ReadUint8(reader);
+            signature.denominator = uint8_t(1 << std::min<int>(ReadUint8(reader), 7));
+            signature.clocks_per_click = ReadUint8(reader);
+            signature.notated_32nds_per_quarter = ReadUint8(reader);
+        }
+        else { // Skip data
+            Skip(reader, length);
+        }
+    }
+    else if (status == 0xf0) { // SysEx event
+        uint32_t length = ReadVariableLengthQuantity(reader);
+        Skip(reader, length);
+    }
+    else if (status == 0xf7) { // SysEx event
+        uint32_t length = ReadVariableLengthQuantity(reader);
+        Skip(reader, length);
+    }
+    else if ((status & 0xf0) >= 0x80) { // MIDI event
+        uint8_t message = (status & 0xf0) >> 4;
+        uint32_t length = (message >= 0xc && message < 0xe) ? 1 : 2;
+        if (message == 0x9 || message == 0x8) { // Note On/Off
+            event.channel = status & 0x0f;
+            event.note = ReadUint8(reader);
+            event.velocity = ReadUint8(reader);
+            event.type = message == 0x9 && event.velocity > 0 ? TrackEventType::NoteOn : TrackEventType::NoteOff;
+        }
+        else {
+            Skip(reader, length);
+        }
+    }
+    return event;
+}
 
-    for (int itrack = 0; itrack < midi.ntracks; itrack++) {
-        std::string identifier = ReadString(data, pos, 4);
-        EXPECTS_EQUAL(std::string("MTrk"), identifier)
-        uint32_t chunklen = ReadUint32(data, pos);
-        Track& track = midi.tracks.emplace_back();
-        int ticks = 0;
-        uint8_t current_status = 0;
-        size_t start_pos = pos;
-        while (pos < start_pos + chunklen) {
-            uint32_t delta_time = ReadVariableLengthQuantity(data, pos);
-            ticks += delta_time;
-            uint8_t status = ReadUint8(data, pos);
-            if (status < 0x80) { // Running status
-                status = current_status;
-                pos--; // Unread byte
-            } else {
-                current_status = status;
-            }
-            if (status == 0xff) { // Meta event
-                uint8_t msg = ReadUint8(data, pos);
-                uint32_t length = ReadVariableLengthQuantity(data, pos);
-                if (msg == 0x03) { // Sequence/Track name
-                    std::string track_or_seq_name = ReadString(data, pos, length);
-                    if (midi.format < 2 && itrack == 0) {
-                        midi.sequence_name = std::move(track_or_seq_name);
-                    }
-                    else {
-                        track.name = std::move(track_or_seq_name);
-                    }
-                }
-                else if (msg == 0x2f) {
-                    midi.ticklen = ticks;
-                }
-                else { // Skip data
-                    pos += length;
-                }
-            }
-            else if (status == 0xf0) { // SysEx event
-                uint32_t length = ReadVariableLengthQuantity(data, pos);
-                pos += length;
+int GetNoteKey(uint8_t channel, uint8_t note)
+{
+    return channel * (MIDI_NOTE_MAX + 1) + (note & MIDI_NOTE_MAX);
+}
+
+void InitOpenNotes(OpenNotes& notes)
+{
+    notes.head.assign(16 * (MIDI_NOTE_MAX + 1), -1);
+    notes.tail.assign(16 * (MIDI_NOTE_MAX + 1), -1);
+    notes.next.clear();
+    notes.first = 0;
+    notes.dropped.assign(16 * (MIDI_NOTE_MAX + 1), 0);
+}
+
+// Note On of note inote, numbered right after the previous one
+void PushOpenNote(OpenNotes& notes, int key, int64_t inote)
+{
+    notes.next.push_back(-1);
+    if (notes.tail[key] >= 0) {
+        notes.next[notes.tail[key] - notes.first] = inote;
+    }
+    else {
+        notes.head[key] = inote;
+    }
+    notes.tail[key] = inote;
+}
+
+// Note Off: returns the note it releases, -1 if none
+int64_t PopOpenNote(OpenNotes& notes, int key)
+{
+    if (notes.dropped[key] > 0) {
+        notes.dropped[key]--;
+        return -1;
+    }
+    int64_t inote = notes.head[key];
+    if (inote >= 0) {
+        notes.head[key] = notes.next[inote - notes.first];
+        if (notes.head[key] < 0) {
+            notes.tail[key] = -1;
+        }
+    }
+    return inote;
+}
+
+// Stops tracking the oldest note, is_open if it hasn't been released yet
+void DropOpenNote(OpenNotes& notes, int key, bool is_open)
+{
+    if (is_open) { // It is the head of its FIFO
+        notes.dropped[key]++;
+        notes.head[key] = notes.next.front();
+        if (notes.head[key] < 0) {
+            notes.tail[key] = -1;
+        }
+    }
+    notes.next.pop_front();
+    notes.first++;
+}
+
+// End of the track: calls close(inote) for every note still waiting for its Note Off, in no
+// particular order, and forgets them
+template <typename Fn>
+void CloseOpenNotes(OpenNotes& notes, Fn const& close)
+{
+    for (size_t key = 0; key < notes.head.size(); key++) {
+        for (int64_t inote = notes.head[key]; inote >= 0; inote = notes.next[inote - notes.first]) {
+            close(inote);
+        }
+        notes.head[key] = -1;
+        notes.tail[key] = -1;
+    }
+}
+
+// Without events, only counts the notes of the track into info.nevents so storage can be sized up front.
+// With events, which must hold info.nevents, fills them and the rest of info.
+void DecodeTrack(MidiReader& reader, Event* events, TrackInfo& info)
+{
+    bool counting = events == nullptr;
+    int ticks = 0;
+    int ievent = 0;
+    uint8_t current_status = 0;
+    OpenNotes open_notes;
+    if (!counting) {
+        InitOpenNotes(open_notes);
+    }
+    while (reader.pos < reader.data.size()) {
+        TrackEvent track_event = ReadTrackEvent(reader, ticks, current_status, counting);
+        int key = GetNoteKey(track_event.channel, track_event.note);
+        switch (track_event.type) {
+        case TrackEventType::NoteOn:
+            if (!counting && ievent >= int(info.nevents)) { // The passes read the track differently
+                Fail(reader, std::format("More notes than the {} counted", info.nevents));
+                return;
             }
-            else if (status == 0xf7) { // SysEx event
-                uint32_t length = ReadVariableLengthQuantity(data, pos);
-                pos += length;
+            if (!counting) {
+                Event& event = events[ievent];
+                event.channel = track_event.channel;
+                event.start_ticks = ticks;
+                event.duration_ticks = -1;
+                event.note = track_event.note;
+                event.velocity = track_event.velocity;
+                PushOpenNote(open_notes, key, ievent);
             }
-            else if ((status & 0xf0) >= 0x80) { // MIDI event
-                uint8_t channel = status & 0x0f;
-                uint8_t message = (status & 0xf0) >> 4;
-                uint32_t length = (message >= 0xc && message < 0xe) ? 1 : 2;
-                if (message == 0x9) { // Note On
-                    uint8_t note = ReadUint8(data, pos);
-                    uint8_t velocity = ReadUint8(data, pos);
-                    Event& event = track.events.emplace_back();
-                    event.channel = channel;
-                    event.start_ticks = ticks;
-                    event.note = note;
-                    event.velocity = velocity;
-                }
-                else {
-                    pos += length;
+            ievent++;
+            break;
+        case TrackEventType::NoteOff:
+            if (!counting) {
+                int64_t iopen = PopOpenNote(open_notes, key);
+                if (iopen >= 0) {
+                    Event& event = events[iopen];
+                    event.duration_ticks = ticks - event.start_ticks;
                 }
             }
+            break;
+        case TrackEventType::Name:
+            info.name = track_event.name;
+            break;
+        case TrackEventType::EndOfTrack:
+            info.end_ticks = ticks;
+            break;
+        case TrackEventType::Tempo:
+            info.tempos.push_back(Tempo{ ticks, track_event.usec_per_quarter, 0.0 });
+            break;
+        case TrackEventType::TimeSignature:
+            info.time_signatures.push_back(track_event.time_signature);
+            break;
+        case TrackEventType::Other:
+            break;
         }
     }
+    if (counting) {
+        info.nevents = ievent;
+        return;
+    }
+    // Notes never released last until the end of the track
+    int end_ticks = info.end_ticks >= 0 ? info.end_ticks : ticks;
+    CloseOpenNotes(open_notes, [&](int64_t inote) {
+        events[inote].duration_ticks = end_ticks - events[inote].start_ticks;
+    });
+}
+
+// Runs fn(i) for i in [0, count), spread over nthreads threads including the calling one
+template <typename Fn>
+void ParallelFor(int count, int nthreads, Fn const& fn)
+{
+    std::atomic<int> next = 0;
+    auto run = [&] {
+        for (int i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+    std::vector<std::jthread> workers;
+    for (int i = 1; i < nthreads; i++) {
+        workers.emplace_back(run);
+    }
+    run();
+}
+
+// Sorts the tempo changes gathered from all tracks and precomputes the time at which each one starts
+void BuildTempoMap(std::vector<Tempo>& tempo_map, int16_t tickdiv)
+{
+    if (tickdiv < 0) { // SMPTE timing, tempo changes don't apply
+        tempo_map.clear();
+        return;
+    }
+    std::ranges::stable_sort(tempo_map, {}, &Tempo::ticks);
+    // When several tempos share a tick, the last one read wins
+    auto same_tick = [](Tempo const& a, Tempo const& b) { return a.ticks == b.ticks; };
+    auto last_of_run = std::unique(tempo_map.rbegin(), tempo_map.rend(), same_tick);
+    tempo_map.erase(tempo_map.begin(), last_of_run.base());
+    if (tempo_map.empty() || tempo_map.front().ticks > 0) {
+        tempo_map.insert(tempo_map.begin(), Tempo{ 0, MIDI_TEMPO_DEF, 0.0 });
+    }
+    for (size_t i = 1; i < tempo_map.size(); i++) {
+        Tempo const& previous = tempo_map[i - 1];
+        double delta_ticks = tempo_map[i].ticks - previous.ticks;
+        tempo_map[i].seconds = previous.seconds + delta_ticks * previous.usec_per_quarter / (1e6 * tickdiv);
+    }
+}
+
+double TicksToSeconds(Midi const& midi, int ticks)
+{
+    return TicksToSeconds(midi.tempo_map, midi.tickdiv, ticks);
+}
+
+double TicksToSeconds(std::span<Tempo const> tempo_map, int16_t tickdiv, int ticks)
+{
+    if (tickdiv < 0) { // SMPTE: high byte is -frames per second, low byte is ticks per frame
+        int frames_per_second = -(tickdiv >> 8);
+        int ticks_per_frame = tickdiv & 0xff;
+        return (double)ticks / (frames_per_second * ticks_per_frame);
+    }
+    // Last tempo change at or before ticks
+    auto it = std::ranges::upper_bound(tempo_map, ticks, {}, &Tempo::ticks);
+    if (it == tempo_map.begin()) {
+        return (double)ticks * MIDI_TEMPO_DEF / (1e6 * tickdiv);
+    }
+    Tempo const& tempo = *(it - 1);
+    return tempo.seconds + (double)(ticks - tempo.ticks) * tempo.usec_per_quarter / (1e6 * tickdiv);
+}
+
+// Parses the header chunk and locates the track chunks
+std::expected<std::vector<TrackChunk>, MidiError> ReadChunks(MidiReader& reader, int16_t& format, int16_t& ntracks, int16_t& tickdiv)
+{
+    std::string_view identifier = ReadString(reader, 4);
+    if (!reader.error && identifier != "MThd") {
+        return std::unexpected(MidiError{ 0, std::format("Expected 'MThd', got '{}'", identifier) });
+    }
+    uint32_t chunklen = ReadUint32(reader);
+    size_t header_pos = reader.pos;
+    format = ReadUint16(reader);
+    ntracks = ReadUint16(reader);
+    tickdiv = ReadUint16(reader);
+    if (!reader.error && chunklen < 6) {
+        return std::unexpected(MidiError{ 4, std::format("Header chunk too short: {}", chunklen) });
+    }
+    if (!reader.error && ntracks < 0) {
+        return std::unexpected(MidiError{ 10, std::format("Too many tracks: {}", uint16_t(ntracks)) });
+    }
+    if (!reader.error) {
+        reader.pos = header_pos;
+        Skip(reader, chunklen);
+    }
+
+    std::vector<TrackChunk> chunks;
+    while (!reader.error && chunks.size() < ntracks) {
+        std::string_view identifier = ReadString(reader, 4);
+        uint32_t length = ReadUint32(reader);
+        if (identifier == "MTrk") {
+            chunks.push_back(TrackChunk{ reader.pos, length });
+        }
+        Skip(reader, length); // Unknown chunks are ignored
+    }
+    if (reader.error) {
+        return std::unexpected(std::move(*reader.error));
+    }
+    return chunks;
+}
+
+std::expected<Midi, MidiError> TryLoadMidi(std::span<uint8_t const> data)
+{
+    Midi midi;
+    midi.ticklen = 0;
+    MidiReader reader{ data };
+    // First pass: locate every track chunk so they can be decoded independently
+    auto chunks_or_error = ReadChunks(reader, midi.format, midi.ntracks, midi.tickdiv);
+    if (!chunks_or_error) {
+        return std::unexpected(std::move(chunks_or_error.error()));
+    }
+    std::vector<TrackChunk> const& chunks = *chunks_or_error;
+
+    // Then count and decode the tracks, in parallel when there is enough work to share.
+    // Counting first lets every event live in a single allocation.
+    midi.tracks.reserve(midi.ntracks);
+    std::vector<TrackInfo> infos(midi.ntracks);
+    std::vector<std::optional<MidiError>> errors(midi.ntracks);
+    int nthreads = 1;
+    if (reader.pos >= MIDI_PARALLEL_MIN_SIZE) {
+        nthreads = std::clamp(int(std::thread::hardware_concurrency()), 1, std::max<int>(midi.ntracks, 1));
+    }
+    auto decode_track = [&](int itrack, Event* events) {
+        TrackChunk const& chunk = chunks[itrack];
+        MidiReader track_reader{ data.subspan(chunk.offset, chunk.length) };
+        DecodeTrack(track_reader, events, infos[itrack]);
+        if (track_reader.error) {
+            errors[itrack] = std::move(track_reader.error);
+            errors[itrack]->offset += chunk.offset;
+        }
+    };
+    ParallelFor(midi.ntracks, nthreads, [&](int itrack) {
+        decode_track(itrack, nullptr);
+    });
+    for (int itrack = 0; itrack < midi.ntracks; itrack++) {
+        if (errors[itrack]) {
+            return std::unexpected(std::move(*errors[itrack]));
+        }
+    }
+    std::vector<size_t> first_event(midi.ntracks + 1, 0);
+    for (int itrack = 0; itrack < midi.ntracks; itrack++) {
+        first_event[itrack + 1] = first_event[itrack] + infos[itrack].nevents;
+    }
+    midi.events.resize(first_event.back());
+    ParallelFor(midi.ntracks, nthreads, [&](int itrack) {
+        decode_track(itrack, midi.events.data() + first_event[itrack]);
+    });
+
+    // Merge in file order so the result matches a serial decode
+    for (int itrack = 0; itrack < midi.ntracks; itrack++) {
+        if (errors[itrack]) {
+            return std::unexpected(std::move(*errors[itrack]));
+        }
+        TrackInfo& info = infos[itrack];
+        Track& track = midi.tracks.emplace_back();
+        track.name = info.name;
+        track.events = std::span<Event const>(midi.events).subspan(first_event[itrack], info.nevents);
+        if (info.end_ticks >= 0) {
+            midi.ticklen = info.end_ticks;
+        }
+        midi.tempo_map.insert(midi.tempo_map.end(), info.tempos.begin(), info.tempos.end());
+        midi.time_signatures.insert(midi.time_signatures.end(), info.time_signatures.begin(), info.time_signatures.end());
+    }
+    BuildTempoMap(midi.tempo_map, midi.tickdiv);
+    std::ranges::stable_sort(midi.time_signatures, {}, &TimeSignature::ticks);
+    if (midi.format < 2 && midi.ntracks > 0) { // First track name is the sequence name
+        midi.sequence_name = midi.tracks[0].name;
+        midi.tracks[0].name = {};
+    }
     return midi;
 }
+
+Midi LoadMidi(std::span<uint8_t const> data)
+{
+    std::expected<Midi, MidiError> midi = TryLoadMidi(data);
+    if (!midi) {
+        throw std::runtime_error(std::format("{} (at byte {})", midi.error().reason, midi.error().offset));
+    }
+    return std::move(*midi);
+}
+
+std::expected<MidiStream, MidiError> OpenMidiStream(std::span<uint8_t const> data)
+{
+    MidiStream stream;
+    MidiReader reader{ data };
+    auto chunks = ReadChunks(reader, stream.format, stream.ntracks, stream.tickdiv);
+    if (!chunks) {
+        return std::unexpected(std::move(chunks.error()));
+    }
+    stream.tracks.resize(chunks->size());
+    for (size_t i = 0; i < chunks->size(); i++) {
+        TrackChunk const& chunk = (*chunks)[i];
+        MidiStreamTrack& track = stream.tracks[i];
+        track.offset = chunk.offset;
+        track.data = data.subspan(chunk.offset, chunk.length);
+        track.ended = track.data.empty();
+        InitOpenNotes(track.open_notes);
+    }
+    BuildTempoMap(stream.tempo_map, stream.tickdiv);
+    return stream;
+}
+
+// Same pairing as DecodeTrack, over notes that may have been popped already
+void ReadMidiStreamTrack(MidiStreamTrack& track, int ticks, std::optional<MidiError>& error, bool& new_tempos)
+{
+    MidiReader reader{ track.data, track.pos };
+    while (!track.ended && track.ticks < ticks) {
+        TrackEvent track_event = ReadTrackEvent(reader, track.ticks, track.current_status, false);
+        int key = GetNoteKey(track_event.channel, track_event.note);
+        if (track_event.type == TrackEventType::NoteOn) {
+            int64_t inote = track.open_notes.first + int64_t(track.notes.size());
+            track.notes.push_back(Event{ track_event.channel, track_event.note, track_event.velocity, track.ticks, -1 });
+            PushOpenNote(track.open_notes, key, inote);
+        }
+        else if (track_event.type == TrackEventType::NoteOff) {
+            int64_t iopen = PopOpenNote(track.open_notes, key);
+            if (iopen >= 0) {
+                Event& event = track.notes[iopen - track.open_notes.first];
+                event.duration_ticks = track.ticks - event.start_ticks;
+            }
+        }
+        else if (track_event.type == TrackEventType::EndOfTrack) {
+            track.end_ticks = track.ticks;
+        }
+        else if (track_event.type == TrackEventType::Tempo) {
+            track.tempos.push_back(Tempo{ track.ticks, track_event.usec_per_quarter, 0.0 });
+            new_tempos = true;
+        }
+        track.ended = reader.pos >= reader.data.size();
+    }
+    track.pos = reader.pos;
+    if (reader.error) {
+        error = std::move(reader.error);
+        error->offset += track.offset;
+        return;
+    }
+    if (track.ended) { // Notes never released last until the end of the track
+        int end_ticks = track.end_ticks >= 0 ? track.end_ticks : track.ticks;
+        CloseOpenNotes(track.open_notes, [&](int64_t inote) {
+            Event& event = track.notes[inote - track.open_notes.first];
+            event.duration_ticks = end_ticks - event.start_ticks;
+        });
+    }
+}
+
+bool ReadMidiStream(MidiStream& stream, int ticks)
+{
+    if (stream.error) {
+        return false;
+    }
+    bool new_tempos = false;
+    for (MidiStreamTrack& track : stream.tracks) {
+        ReadMidiStreamTrack(track, ticks, stream.error, new_tempos);
+        if (stream.error) {
+            return false;
+        }
+    }
+    if (new_tempos) { // Gathered in file order, as TryLoadMidi does
+        stream.tempo_map.clear();
+        for (MidiStreamTrack const& track : stream.tracks) {
+            stream.tempo_map.insert(stream.tempo_map.end(), track.tempos.begin(), track.tempos.end());
+        }
+        BuildTempoMap(stream.tempo_map, stream.tickdiv);
+    }
+    stream.ticks = std::max(stream.ticks, ticks);
+    return true;
+}
+
+bool MidiStreamEnded(MidiStream const& stream)
+{
+    return std::ranges::all_of(stream.tracks, &MidiStreamTrack::ended);
+}
+
+void PopMidiStreamNote(MidiStreamTrack& track)
+{
+    Event const& event = track.notes.front();
+    DropOpenNote(track.open_notes, GetNoteKey(event.channel, event.note), event.duration_ticks < 0);
+    track.notes.pop_front();
+}
@@ -1,31 +1,118 @@
+#pragma once
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <expected>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #define MIDI_NOTE_MAX 127
 #define MIDI_NOTE_MIN 0
 #define MIDI_NOTE_DEF 64
+#define MIDI_TEMPO_DEF 500000 // 120 BPM, in microseconds per quarter note
 
 struct Event {
     uint8_t channel;
     uint8_t note;
     uint8_t velocity;
     int start_ticks;
+    int duration_ticks; // Until the matching Note Off, or the end of the track
+};
+
+struct Tempo {
+    int ticks;
+    uint32_t usec_per_quarter;
+    double seconds; // Time at which this tempo starts
+};
+
+struct TimeSignature {
+    int ticks;
+    uint8_t numerator;
+    uint8_t denominator; // Power of two, 4 for x/4
+    uint8_t clocks_per_click;
+    uint8_t notated_32nds_per_quarter;
 };
 
 struct Track {
-    std::string name;
-    std::vector<Event> events;
+    std::string_view name; // Points into the source data
+    std::span<Event const> events; // Slice of Midi::events
 };
 
+// Views into the source data and into its own event storage: must not outlive the data it was
+// loaded from, and can be moved but not copied.
 struct Midi {
+    Midi() = default;
+    Midi(Midi&&) = default;
+    Midi& operator=(Midi&&) = default;
+    Midi(Midi const&) = delete;
+    Midi& operator=(Midi const&) = delete;
+
     int16_t format;
     int16_t ntracks;
     int16_t tickdiv;
     int32_t ticklen;
-    std::string sequence_name;
+    std::string_view sequence_name;
     std::vector<Track> tracks;
+    std::vector<Event> events; // Every track's events in a single allocation, track after track
+    std::vector<Tempo> tempo_map; // Sorted by ticks, starts at tick 0. Empty for SMPTE timing.
+    std::vector<TimeSignature> time_signatures;
+};
+
+struct MidiError {
+    size_t offset; // Byte offset in the file where decoding failed
+    std::string reason;
+};
+
+// Throws std::runtime_error on malformed data
+Midi LoadMidi(std::span<uint8_t const> data);
+std::expected<Midi, MidiError> TryLoadMidi(std::span<uint8_t const> data);
+double TicksToSeconds(Midi const& midi, int ticks);
+double TicksToSeconds(std::span<Tempo const> tempo_map, int16_t tickdiv, int ticks);
+
+// Notes waiting for their Note Off, as a FIFO per channel and key so overlapping notes pair in order.
+// Notes are numbered in Note On order from 0. The oldest ones can be dropped before their Note Off,
+// which then pairs with nothing.
+struct OpenNotes {
+    std::vector<int64_t> head; // Per channel and key, -1 when no note is waiting
+    std::vector<int64_t> tail;
+    std::deque<int64_t> next; // Next note of the same channel and key, from note first on
+    int64_t first = 0; // Number of notes dropped so far
+    std::vector<int> dropped; // Per channel and key, notes dropped before their Note Off, the oldest of the FIFO
+};
+
+// One track of a MidiStream, decoded as far as the stream has been read
+struct MidiStreamTrack {
+    size_t offset; // Of the track data in the source data, for errors
+    std::span<uint8_t const> data;
+    size_t pos = 0;
+    int ticks = 0; // Of the last event read
+    uint8_t current_status = 0;
+    bool ended = false; // Every event was read
+    int end_ticks = -1; // No End of Track event
+    std::vector<Tempo> tempos;
+    // Notes read and not popped yet, in Note On order. Duration is -1 until the Note Off is read.
+    std::deque<Event> notes;
+    OpenNotes open_notes; // Its first is the number of notes popped so far, the index of notes.front()
+};
+
+// Decodes a file a few ticks at a time instead of all at once, so long files can be consumed while
+// they are being read. Views into the source data, which must outlive it.
+struct MidiStream {
+    int16_t format;
+    int16_t ntracks;
+    int16_t tickdiv;
+    int ticks = 0; // Every track has been read at least up to here, or has ended
+    std::vector<MidiStreamTrack> tracks;
+    std::vector<Tempo> tempo_map; // Like Midi::tempo_map, exact before ticks
+    std::optional<MidiError> error;
 };
 
-Midi LoadMidi(std::span<uint8_t const> data);
\ No newline at end of file
+std::expected<MidiStream, MidiError> OpenMidiStream(std::span<uint8_t const> data);
+// Reads every track up to ticks, returns false on malformed data, which sets stream.error
+bool ReadMidiStream(MidiStream& stream, int ticks);
+bool MidiStreamEnded(MidiStream const& stream);
+// Drops the first note of a track, its Note Off may still be pending
+void PopMidiStreamNote(MidiStreamTrack& track);
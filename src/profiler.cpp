@@ -0,0 +1,135 @@
+#include "profiler.h"
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+static float ToMilliseconds(Profiler::Clock::duration duration)
+{
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+void BeginProfileFrame(Profiler& profiler)
+{
+    Profiler::Clock::time_point now = Profiler::Clock::now();
+    if (profiler.nframes) {
+        ProfileFrame& previous = profiler.frames[(profiler.nframes - 1) % PROFILER_FRAMES];
+        previous.cpu_ms[int(ProfilePhase::Frame)] = ToMilliseconds(now - profiler.frame_start);
+    }
+    ProfileFrame& frame = profiler.frames[profiler.nframes % PROFILER_FRAMES];
+    std::fill(std::begin(frame.cpu_ms), std::end(frame.cpu_ms), 0.0f);
+    std::fill(std::begin(frame.gpu_ms), std::end(frame.gpu_ms), -1.0f);
+    profiler.nframes++;
+    profiler.frame_start = now;
+}
+
+void BeginProfilePhase(Profiler& profiler, ProfilePhase phase)
+{
+    profiler.phase_start[int(phase)] = Profiler::Clock::now();
+}
+
+void EndProfilePhase(Profiler& profiler, ProfilePhase phase)
+{
+    if (!profiler.nframes) {
+        return;
+    }
+    ProfileFrame& frame = profiler.frames[(profiler.nframes - 1) % PROFILER_FRAMES];
+    frame.cpu_ms[int(phase)] += ToMilliseconds(Profiler::Clock::now() - profiler.phase_start[int(phase)]);
+}
+
+void BeginProfilePhase(Profiler* profiler, ProfilePhase phase)
+{
+    if (profiler) {
+        BeginProfilePhase(*profiler, phase);
+    }
+}
+
+void EndProfilePhase(Profiler* profiler, ProfilePhase phase)
+{
+    if (profiler) {
+        EndProfilePhase(*profiler, phase);
+    }
+}
+
+ProfileFrame* GetProfileFrame(Profiler& profiler, size_t frame)
+{
+    if (frame >= profiler.nframes || profiler.nframes - frame > PROFILER_FRAMES) {
+        return nullptr;
+    }
+    return &profiler.frames[frame % PROFILER_FRAMES];
+}
+
+ProfileStats GetProfileStats(Profiler const& profiler, ProfilePhase phase, bool gpu)
+{
+    float samples[PROFILER_FRAMES];
+    int nsamples = 0;
+    size_t ncompleted = std::min(profiler.nframes ? profiler.nframes - 1 : 0, size_t(PROFILER_FRAMES - 1));
+    for (size_t i = profiler.nframes - 1 - ncompleted; i + 1 < profiler.nframes; i++) {
+        ProfileFrame const& frame = profiler.frames[i % PROFILER_FRAMES];
+        float ms = gpu ? frame.gpu_ms[int(phase)] : frame.cpu_ms[int(phase)];
+        if (ms >= 0.0f) {
+            samples[nsamples++] = ms;
+        }
+    }
+    ProfileStats stats;
+    stats.nsamples = nsamples;
+    if (!nsamples) {
+        return stats;
+    }
+    float* p50 = samples + nsamples / 2;
+    std::nth_element(samples, p50, samples + nsamples);
+    stats.p50 = *p50;
+    float* p99 = samples + (nsamples * 99) / 100;
+    std::nth_element(p50, p99, samples + nsamples);
+    stats.p99 = *p99;
+    return stats;
+}
+
+char const* GetProfilePhaseName(ProfilePhase phase)
+{
+    switch (phase) {
+    case ProfilePhase::Frame: return "Frame";
+    case ProfilePhase::Input: return "Input";
+    case ProfilePhase::Spawns: return "Spawns";
+    case ProfilePhase::Enemies: return "Enemies";
+    case ProfilePhase::Bullets: return "Bullets";
+    case ProfilePhase::Scene: return "Scene";
+    case ProfilePhase::Hud: return "HUD";
+    case ProfilePhase::Threshold: return "Threshold";
+    case ProfilePhase::Blur: return "Blur";
+    case ProfilePhase::Composite: return "Composite";
+    case ProfilePhase::Crt: return "CRT";
+    case ProfilePhase::Present: return "Present";
+    default: return "?";
+    }
+}
+
+void SaveProfile(Profiler const& profiler, std::string const& filepath)
+{
+    std::ofstream file(filepath, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::format("Can't open file for writing: {}", filepath));
+    }
+    file << "frame";
+    for (int phase = 0; phase < int(ProfilePhase::Count); phase++) {
+        char const* name = GetProfilePhaseName(ProfilePhase(phase));
+        file << std::format(",{} cpu ms,{} gpu ms", name, name);
+    }
+    file << '\n';
+    // The current frame isn't complete
+    size_t ncompleted = std::min(profiler.nframes ? profiler.nframes - 1 : 0, size_t(PROFILER_FRAMES - 1));
+    for (size_t i = profiler.nframes - 1 - ncompleted; i + 1 < profiler.nframes; i++) {
+        ProfileFrame const& frame = profiler.frames[i % PROFILER_FRAMES];
+        file << i;
+        for (int phase = 0; phase < int(ProfilePhase::Count); phase++) {
+            file << std::format(",{:.4f},", frame.cpu_ms[phase]);
+            if (frame.gpu_ms[phase] >= 0.0f) {
+                file << std::format("{:.4f}", frame.gpu_ms[phase]);
+            }
+        }
+        file << '\n';
+    }
+    if (!file) {
+        throw std::runtime_error(std::format("Error writing file: {}", filepath));
+    }
+}
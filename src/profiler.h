@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+#define PROFILER_FRAMES 512 // Frames kept for the graphs, percentiles and dump
+
+enum class ProfilePhase {
+    Frame, // From one BeginProfileFrame to the next
+    Input,
+    Spawns, // Activating and retiring enemies, over every step of the frame
+    Enemies, // Collisions and hits
+    Bullets,
+    Scene,
+    Hud,
+    Threshold,
+    Blur,
+    Composite,
+    Crt,
+    Present, // Swapping buffers, including the wait for vsync
+    Count,
+};
+
+struct ProfileFrame {
+    float cpu_ms[int(ProfilePhase::Count)];
+    float gpu_ms[int(ProfilePhase::Count)]; // Negative until a GPU timer result comes back, if ever
+};
+
+struct ProfileStats {
+    float p50 = 0.0f;
+    float p99 = 0.0f;
+    int nsamples = 0;
+};
+
+// CPU time spent in each phase of the last PROFILER_FRAMES frames, with the GPU time when GPU timers
+// fill it (see gpu_timers.h). A phase can be entered several times in a frame, its times add up.
+// Only uses the standard library, so the simulation can time its phases in the headless runner too.
+struct Profiler {
+    using Clock = std::chrono::steady_clock;
+
+    ProfileFrame frames[PROFILER_FRAMES] = {};
+    size_t nframes = 0; // Begun since the start, the current one is the last
+    Clock::time_point frame_start;
+    Clock::time_point phase_start[int(ProfilePhase::Count)];
+};
+
+// Ends the current frame and starts the next one
+void BeginProfileFrame(Profiler& profiler);
+void BeginProfilePhase(Profiler& profiler, ProfilePhase phase);
+void EndProfilePhase(Profiler& profiler, ProfilePhase phase);
+// Do nothing without a profiler
+void BeginProfilePhase(Profiler* profiler, ProfilePhase phase);
+void EndProfilePhase(Profiler* profiler, ProfilePhase phase);
+// Frame index is the number of frames begun before it, null once it has left the ring
+ProfileFrame* GetProfileFrame(Profiler& profiler, size_t frame);
+// Over the frames in the ring but the current one
+ProfileStats GetProfileStats(Profiler const& profiler, ProfilePhase phase, bool gpu);
+char const* GetProfilePhaseName(ProfilePhase phase);
+// Writes the frames in the ring as CSV, oldest first
+void SaveProfile(Profiler const& profiler, std::string const& filepath);
+
+// Times the phase until the end of the scope, does nothing without a profiler
+class ProfileScope {
+public:
+    ProfileScope(Profiler* profiler, ProfilePhase phase) : profiler(profiler), phase(phase) { BeginProfilePhase(profiler, phase); }
+    ~ProfileScope() { EndProfilePhase(profiler, phase); }
+    ProfileScope(ProfileScope const&) = delete;
+    ProfileScope& operator=(ProfileScope const&) = delete;
+
+private:
+    Profiler* profiler;
+    ProfilePhase phase;
+};
@@ -0,0 +1,242 @@
+#include "replay.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+static_assert(sizeof(ReplayFileHeader) == 32, "ReplayFileHeader layout is part of the replay file format");
+
+static uint8_t PackButtons(Inputs const& inputs)
+{
+    return uint8_t(
+        inputs.start << 0 |
+        inputs.pause << 1 |
+        inputs.fire << 2 |
+        inputs.reset << 3 |
+        inputs.stop << 4 |
+        inputs.debug_overlay << 5 |
+        inputs.fullscreen << 6 |
+        inputs.rewind << 7
+    );
+}
+
+static void UnpackButtons(uint8_t buttons, Inputs& inputs)
+{
+    inputs.start = buttons & (1 << 0);
+    inputs.pause = buttons & (1 << 1);
+    inputs.fire = buttons & (1 << 2);
+    inputs.reset = buttons & (1 << 3);
+    inputs.stop = buttons & (1 << 4);
+    inputs.debug_overlay = buttons & (1 << 5);
+    inputs.fullscreen = buttons & (1 << 6);
+    inputs.rewind = buttons & (1 << 7);
+}
+
+static bool SameBits(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static void WriteFloat(std::vector<uint8_t>& stream, float value)
+{
+    uint8_t bytes[sizeof(float)];
+    std::memcpy(bytes, &value, sizeof(float));
+    stream.insert(stream.end(), bytes, bytes + sizeof(float));
+}
+
+// Same encoding as MIDI delta times, without the length limit
+static void WriteVariableLengthQuantity(std::vector<uint8_t>& stream, uint64_t value)
+{
+    uint8_t bytes[10];
+    int nbytes = 0;
+    do {
+        bytes[nbytes++] = value & 0x7F;
+        value >>= 7;
+    } while (value);
+    while (nbytes--) {
+        stream.push_back(bytes[nbytes] | (nbytes ? 0x80 : 0x00));
+    }
+}
+
+static bool ReadFloat(std::vector<uint8_t> const& stream, size_t& pos, float& value)
+{
+    if (stream.size() - pos < sizeof(float)) {
+        return false;
+    }
+    std::memcpy(&value, stream.data() + pos, sizeof(float));
+    pos += sizeof(float);
+    return true;
+}
+
+static bool ReadVariableLengthQuantity(std::vector<uint8_t> const& stream, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (int i = 0; i < 10 && pos < stream.size(); i++) {
+        uint8_t byte = stream[pos++];
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Applies the record at pos to inputs, the step count before it has already been read
+static bool ReadRecord(std::vector<uint8_t> const& stream, size_t& pos, Inputs& inputs)
+{
+    if (pos >= stream.size()) {
+        return false;
+    }
+    uint8_t changed = stream[pos++];
+    if (changed & ~(REPLAY_CHANGED_BUTTONS | REPLAY_CHANGED_DIR | REPLAY_CHANGED_PAN)) {
+        return false;
+    }
+    if (changed & REPLAY_CHANGED_BUTTONS) {
+        if (pos >= stream.size()) {
+            return false;
+        }
+        UnpackButtons(stream[pos++], inputs);
+    }
+    if (changed & REPLAY_CHANGED_DIR) {
+        if (!ReadFloat(stream, pos, inputs.dir.x) || !ReadFloat(stream, pos, inputs.dir.y)) {
+            return false;
+        }
+    }
+    if (changed & REPLAY_CHANGED_PAN) {
+        if (!ReadFloat(stream, pos, inputs.pan)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BeginRecording(ReplayRecorder& recorder, uint64_t level_hash, uint32_t seed)
+{
+    std::memcpy(recorder.header.magic, REPLAY_FILE_MAGIC, sizeof(recorder.header.magic));
+    recorder.header.version = REPLAY_FILE_VERSION;
+    recorder.header.level_hash = level_hash;
+    recorder.header.seed = seed;
+    recorder.header.tick_rate = SIM_TICK_RATE;
+    recorder.header.nticks = 0;
+    recorder.stream.clear();
+    recorder.previous = {};
+    recorder.previous_record_tick = 0;
+}
+
+void RecordInputs(ReplayRecorder& recorder, Inputs const& inputs)
+{
+    uint64_t tick = recorder.header.nticks++;
+    Inputs const& previous = recorder.previous;
+    uint8_t changed = 0;
+    if (PackButtons(inputs) != PackButtons(previous)) {
+        changed |= REPLAY_CHANGED_BUTTONS;
+    }
+    if (!SameBits(inputs.dir.x, previous.dir.x) || !SameBits(inputs.dir.y, previous.dir.y)) {
+        changed |= REPLAY_CHANGED_DIR;
+    }
+    if (!SameBits(inputs.pan, previous.pan)) {
+        changed |= REPLAY_CHANGED_PAN;
+    }
+    if (!changed) {
+        return;
+    }
+
+    std::vector<uint8_t>& stream = recorder.stream;
+    WriteVariableLengthQuantity(stream, tick - recorder.previous_record_tick);
+    stream.push_back(changed);
+    if (changed & REPLAY_CHANGED_BUTTONS) {
+        stream.push_back(PackButtons(inputs));
+    }
+    if (changed & REPLAY_CHANGED_DIR) {
+        WriteFloat(stream, inputs.dir.x);
+        WriteFloat(stream, inputs.dir.y);
+    }
+    if (changed & REPLAY_CHANGED_PAN) {
+        WriteFloat(stream, inputs.pan);
+    }
+    recorder.previous = inputs;
+    recorder.previous_record_tick = tick;
+}
+
+void SaveReplay(ReplayRecorder const& recorder, std::string const& filepath)
+{
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::format("Can't open file for writing: {}", filepath));
+    }
+    file.write(reinterpret_cast<char const*>(&recorder.header), sizeof(recorder.header));
+    file.write(reinterpret_cast<char const*>(recorder.stream.data()), recorder.stream.size());
+    if (!file) {
+        throw std::runtime_error(std::format("Error writing file: {}", filepath));
+    }
+}
+
+Replay LoadReplay(std::string const& filepath)
+{
+    Replay replay;
+    MappedFile file(filepath);
+    std::span<uint8_t const> data = file.Data();
+    if (data.size() < sizeof(replay.header)) {
+        throw std::runtime_error(std::format("Replay too small: {}", filepath));
+    }
+    std::memcpy(&replay.header, data.data(), sizeof(replay.header));
+    if (std::memcmp(replay.header.magic, REPLAY_FILE_MAGIC, sizeof(replay.header.magic)) != 0) {
+        throw std::runtime_error(std::format("Not a replay: {}", filepath));
+    }
+    if (replay.header.version != REPLAY_FILE_VERSION) {
+        throw std::runtime_error(std::format("Replay version {} unsupported, expected {}: {}", replay.header.version, REPLAY_FILE_VERSION, filepath));
+    }
+    if (replay.header.tick_rate != SIM_TICK_RATE) {
+        throw std::runtime_error(std::format("Replay recorded at {} ticks per second, expected {}: {}", replay.header.tick_rate, SIM_TICK_RATE, filepath));
+    }
+    replay.stream.assign(data.begin() + sizeof(replay.header), data.end());
+
+    // Walk the stream once, so replaying can't run into a truncated record
+    size_t pos = 0;
+    uint64_t tick = 0;
+    Inputs inputs = {};
+    bool first_record = true;
+    while (pos < replay.stream.size()) {
+        uint64_t delta = 0;
+        if (!ReadVariableLengthQuantity(replay.stream, pos, delta) || !ReadRecord(replay.stream, pos, inputs)) {
+            throw std::runtime_error(std::format("Corrupted replay stream at byte {}: {}", sizeof(replay.header) + pos, filepath));
+        }
+        if (!first_record && delta == 0) { // One record per tick at most
+            throw std::runtime_error(std::format("Corrupted replay stream at byte {}: {}", sizeof(replay.header) + pos, filepath));
+        }
+        tick += delta;
+        if (tick >= replay.header.nticks) {
+            throw std::runtime_error(std::format("Replay record past its last tick: {}", filepath));
+        }
+        first_record = false;
+    }
+
+    replay.current = {};
+    replay.next_record_tick = replay.header.nticks;
+    uint64_t delta = 0;
+    if (ReadVariableLengthQuantity(replay.stream, replay.pos, delta)) {
+        replay.next_record_tick = delta;
+    }
+    return replay;
+}
+
+bool ReadReplayInputs(Replay& replay, Inputs& inputs)
+{
+    if (replay.tick >= replay.header.nticks) {
+        return false;
+    }
+    if (replay.tick == replay.next_record_tick) {
+        ReadRecord(replay.stream, replay.pos, replay.current);
+        uint64_t delta = 0;
+        if (ReadVariableLengthQuantity(replay.stream, replay.pos, delta)) {
+            replay.next_record_tick = replay.tick + delta;
+        }
+        else {
+            replay.next_record_tick = replay.header.nticks;
+        }
+    }
+    inputs = replay.current;
+    replay.tick++;
+    return true;
+}
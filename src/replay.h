@@ -0,0 +1,52 @@
+#pragma once
+#include "simulation.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define REPLAY_FILE_MAGIC "IMRP"
+#define REPLAY_FILE_VERSION 1
+#define REPLAY_FILE_EXTENSION ".rep"
+
+// Which fields of Inputs a record of the replay stream carries
+#define REPLAY_CHANGED_BUTTONS 0x1
+#define REPLAY_CHANGED_DIR 0x2
+#define REPLAY_CHANGED_PAN 0x4
+
+struct ReplayFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t level_hash; // HashLevel of the level played
+    uint32_t seed; // Random seed the session started with
+    uint32_t tick_rate; // SIM_TICK_RATE of the recording, replays only match at the same rate
+    uint64_t nticks;
+};
+
+// The inputs fed to each simulation step, stored as a stream of records written only when they
+// change: the number of steps since the previous record as a variable length quantity, a byte of
+// REPLAY_CHANGED_* flags, then the changed fields. Floats are kept bit for bit so a replay steps
+// the simulation exactly like the recording.
+struct ReplayRecorder {
+    ReplayFileHeader header;
+    std::vector<uint8_t> stream;
+    Inputs previous;
+    uint64_t previous_record_tick = 0;
+};
+
+struct Replay {
+    ReplayFileHeader header;
+    std::vector<uint8_t> stream;
+    size_t pos = 0;
+    Inputs current;
+    uint64_t tick = 0; // Steps replayed so far
+    uint64_t next_record_tick = 0;
+};
+
+void BeginRecording(ReplayRecorder& recorder, uint64_t level_hash, uint32_t seed);
+// Call with the inputs of every step, in order
+void RecordInputs(ReplayRecorder& recorder, Inputs const& inputs);
+void SaveReplay(ReplayRecorder const& recorder, std::string const& filepath);
+
+Replay LoadReplay(std::string const& filepath);
+// Returns false once every recorded step has been replayed
+bool ReadReplayInputs(Replay& replay, Inputs& inputs);
@@ -0,0 +1,63 @@
+#include "resolution_scaler.h"
+#include "rlgl.h"
+#include <algorithm>
+#include <cmath>
+
+void InitResolutionScaler(ResolutionScaler& scaler, float budget, float min_scale, float max_scale)
+{
+    scaler = {};
+    scaler.budget = budget;
+    scaler.min_scale = std::clamp(min_scale, 0.1f, 1.0f);
+    scaler.max_scale = std::clamp(max_scale, scaler.min_scale, 1.0f);
+    scaler.scale = scaler.max_scale;
+}
+
+bool UpdateResolutionScaler(ResolutionScaler& scaler, float frame_time)
+{
+    scaler.frames++;
+    if (frame_time > scaler.budget * RESOLUTION_MISS_TOLERANCE) {
+        scaler.misses++;
+    }
+    if (scaler.frames < RESOLUTION_WINDOW) {
+        return false;
+    }
+
+    float previous_scale = scaler.scale;
+    if (scaler.misses > RESOLUTION_MAX_MISSES) {
+        if (scaler.is_probing) { // The step up didn't fit, wait longer before the next one
+            scaler.probe_windows = std::min(scaler.probe_windows * 2, RESOLUTION_MAX_PROBE_WINDOWS);
+        }
+        scaler.scale = std::max(scaler.scale - RESOLUTION_SCALE_STEP, scaler.min_scale);
+        scaler.is_probing = false;
+        scaler.clean_windows = 0;
+    }
+    else {
+        if (scaler.is_probing) { // The step up fits, the next ones can come sooner again
+            scaler.probe_windows = RESOLUTION_PROBE_WINDOWS;
+        }
+        scaler.is_probing = false;
+        scaler.clean_windows = scaler.misses > RESOLUTION_CLEAN_MISSES ? 0 : scaler.clean_windows + 1;
+        if (scaler.clean_windows >= scaler.probe_windows && scaler.scale < scaler.max_scale) {
+            scaler.scale = std::min(scaler.scale + RESOLUTION_SCALE_STEP, scaler.max_scale);
+            scaler.is_probing = true;
+            scaler.clean_windows = 0;
+        }
+    }
+    scaler.frames = 0;
+    scaler.misses = 0;
+    return scaler.scale != previous_scale;
+}
+
+int GetScaledSize(float size, float scale)
+{
+    return std::max(int(std::lround(size * scale)), 1);
+}
+
+void BeginScaledTextureMode(RenderTexture2D target, float width, float height)
+{
+    BeginTextureMode(target);
+    rlMatrixMode(RL_PROJECTION);
+    rlLoadIdentity();
+    rlOrtho(0, width, height, 0, 0.0f, 1.0f);
+    rlMatrixMode(RL_MODELVIEW);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "raylib.h"
+
+#define RESOLUTION_WINDOW 30 // Frames looked at before each decision
+#define RESOLUTION_MISS_TOLERANCE 1.2f // A frame longer than this many budgets missed it
+#define RESOLUTION_MAX_MISSES 6 // Missed frames in a window that take the scale down, isolated hitches don't
+#define RESOLUTION_CLEAN_MISSES 1 // Missed frames a window can have and still count as clean
+#define RESOLUTION_SCALE_STEP 0.1f
+#define RESOLUTION_PROBE_WINDOWS 4 // Clean windows before trying a step up
+#define RESOLUTION_MAX_PROBE_WINDOWS 64 // Doubled each time a step up has to be undone, up to this
+
+// Which offscreen targets follow the scale
+enum class ResolutionScaleMode {
+    Off,
+    Post, // The bloom chain only
+    All, // The scene and composite targets too
+};
+
+// Picks the render scale from the frame times. With vsync a frame can't be shorter than the budget,
+// so headroom can't be measured: the scale goes down when frames are missed, and up again by probing
+// one step after a run of clean windows. A step up that misses frames is undone and the next probe
+// waits twice as long, so a scale that doesn't fit is not retried every second.
+struct ResolutionScaler {
+    float budget = 1.0f / 60.0f; // Seconds a frame should take
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    float scale = 1.0f;
+    int frames = 0; // In the current window
+    int misses = 0;
+    int clean_windows = 0; // In a row
+    int probe_windows = RESOLUTION_PROBE_WINDOWS;
+    bool is_probing = false; // The last change was a step up that isn't confirmed yet
+};
+
+void InitResolutionScaler(ResolutionScaler& scaler, float budget, float min_scale, float max_scale);
+// Returns true when the scale changed
+bool UpdateResolutionScaler(ResolutionScaler& scaler, float frame_time);
+// Size of a target rendered at scale, never empty
+int GetScaledSize(float size, float scale);
+// BeginTextureMode, with the projection of a width x height target whatever the size of the texture,
+// so the pass draws in game coordinates on a scaled target
+void BeginScaledTextureMode(RenderTexture2D target, float width, float height);
@@ -0,0 +1,210 @@
+#include "shader_cache.h"
+#include "mapped_file.h"
+#include "rlgl.h"
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_WIN32) && !defined(_WIN64)
+#define SHADER_CACHE_APIENTRY __stdcall
+#else
+#define SHADER_CACHE_APIENTRY
+#endif
+
+#define GL_VENDOR 0x1F00
+#define GL_RENDERER 0x1F01
+#define GL_VERSION 0x1F02
+#define GL_LINK_STATUS 0x8B82
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+// None of these are part of what rlgl exposes
+typedef unsigned char const* (SHADER_CACHE_APIENTRY *GetStringProc)(unsigned int name);
+typedef void (SHADER_CACHE_APIENTRY *GetIntegervProc)(unsigned int pname, int* data);
+typedef unsigned int (SHADER_CACHE_APIENTRY *CreateProgramProc)(void);
+typedef void (SHADER_CACHE_APIENTRY *GetProgramivProc)(unsigned int program, unsigned int pname, int* params);
+typedef void (SHADER_CACHE_APIENTRY *GetProgramBinaryProc)(unsigned int program, int size, int* length, unsigned int* format, void* binary);
+typedef void (SHADER_CACHE_APIENTRY *ProgramBinaryProc)(unsigned int program, unsigned int format, void const* binary, int length);
+
+static GetStringProc glGetString = nullptr;
+static GetIntegervProc glGetIntegerv = nullptr;
+static CreateProgramProc glCreateProgram = nullptr;
+static GetProgramivProc glGetProgramiv = nullptr;
+static GetProgramBinaryProc glGetProgramBinary = nullptr;
+static ProgramBinaryProc glProgramBinary = nullptr;
+
+static void HashBytes(uint64_t& hash, void const* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t const*>(data)[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+static void HashString(uint64_t& hash, char const* text)
+{
+    HashBytes(hash, text ? text : "", text ? std::strlen(text) : 0);
+    HashBytes(hash, "", 1); // Keeps "ab" + "c" apart from "a" + "bc"
+}
+
+static std::string GetCachePath(ShaderCache const& cache, char const* fs_filepath)
+{
+    return (std::filesystem::path(cache.directory) / std::filesystem::path(fs_filepath).stem()).string() + SHADER_CACHE_EXTENSION;
+}
+
+// Same locations as LoadShaderFromMemory looks up, by rlgl's default names
+static Shader MakeShader(unsigned int program)
+{
+    Shader shader;
+    shader.id = program;
+    shader.locs = (int*)MemAlloc(RL_MAX_SHADER_LOCATIONS * sizeof(int)); // Freed by UnloadShader
+    for (int i = 0; i < RL_MAX_SHADER_LOCATIONS; i++) {
+        shader.locs[i] = -1;
+    }
+    shader.locs[SHADER_LOC_VERTEX_POSITION] = rlGetLocationAttrib(program, "vertexPosition");
+    shader.locs[SHADER_LOC_VERTEX_TEXCOORD01] = rlGetLocationAttrib(program, "vertexTexCoord");
+    shader.locs[SHADER_LOC_VERTEX_TEXCOORD02] = rlGetLocationAttrib(program, "vertexTexCoord2");
+    shader.locs[SHADER_LOC_VERTEX_NORMAL] = rlGetLocationAttrib(program, "vertexNormal");
+    shader.locs[SHADER_LOC_VERTEX_TANGENT] = rlGetLocationAttrib(program, "vertexTangent");
+    shader.locs[SHADER_LOC_VERTEX_COLOR] = rlGetLocationAttrib(program, "vertexColor");
+    shader.locs[SHADER_LOC_MATRIX_MVP] = rlGetLocationUniform(program, "mvp");
+    shader.locs[SHADER_LOC_MATRIX_VIEW] = rlGetLocationUniform(program, "matView");
+    shader.locs[SHADER_LOC_MATRIX_PROJECTION] = rlGetLocationUniform(program, "matProjection");
+    shader.locs[SHADER_LOC_MATRIX_MODEL] = rlGetLocationUniform(program, "matModel");
+    shader.locs[SHADER_LOC_MATRIX_NORMAL] = rlGetLocationUniform(program, "matNormal");
+    shader.locs[SHADER_LOC_COLOR_DIFFUSE] = rlGetLocationUniform(program, "colDiffuse");
+    shader.locs[SHADER_LOC_MAP_DIFFUSE] = rlGetLocationUniform(program, "texture0");
+    shader.locs[SHADER_LOC_MAP_SPECULAR] = rlGetLocationUniform(program, "texture1");
+    shader.locs[SHADER_LOC_MAP_NORMAL] = rlGetLocationUniform(program, "texture2");
+    return shader;
+}
+
+// Returns 0 if there is no cached program for key or the driver rejects it
+static unsigned int LoadProgramBinary(std::string const& cache_filepath, uint64_t key)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(cache_filepath, ec)) {
+        return 0;
+    }
+    MappedFile file(cache_filepath);
+    std::span<uint8_t const> data = file.Data();
+    ShaderCacheFileHeader header;
+    if (data.size() < sizeof(header)) {
+        return 0;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SHADER_CACHE_VERSION
+        || header.key != key
+        || data.size() - sizeof(header) < header.length) {
+        return 0;
+    }
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.format, data.data() + sizeof(header), int(header.length));
+    int is_linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (!is_linked) { // Drivers may refuse their own binaries after an update that kept the version string
+        rlUnloadShaderProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void SaveProgramBinary(std::string const& cache_filepath, uint64_t key, unsigned int program)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) { // Some drivers don't keep the binaries of programs not linked to be retrieved
+        return;
+    }
+    std::vector<uint8_t> binary(length);
+    ShaderCacheFileHeader header;
+    std::memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    glGetProgramBinary(program, length, &length, &header.format, binary.data());
+    header.length = uint32_t(length);
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_filepath).parent_path(), ec);
+    std::ofstream file(cache_filepath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::format("Can't open file for writing: {}", cache_filepath));
+    }
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(binary.data()), header.length);
+    if (!file) {
+        throw std::runtime_error(std::format("Error writing file: {}", cache_filepath));
+    }
+}
+
+void InitShaderCache(ShaderCache& cache, std::string const& directory)
+{
+    cache = {};
+    cache.directory = directory;
+    if (directory.empty()) {
+        return;
+    }
+    glGetString = (GetStringProc)rlGetProcAddress("glGetString");
+    glGetIntegerv = (GetIntegervProc)rlGetProcAddress("glGetIntegerv");
+    glCreateProgram = (CreateProgramProc)rlGetProcAddress("glCreateProgram");
+    glGetProgramiv = (GetProgramivProc)rlGetProcAddress("glGetProgramiv");
+    glGetProgramBinary = (GetProgramBinaryProc)rlGetProcAddress("glGetProgramBinary");
+    glProgramBinary = (ProgramBinaryProc)rlGetProcAddress("glProgramBinary");
+    if (!glGetString || !glGetIntegerv || !glCreateProgram || !glGetProgramiv || !glGetProgramBinary || !glProgramBinary) {
+        return;
+    }
+    int nformats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+    if (nformats <= 0) {
+        return;
+    }
+    // The default vertex shader comes with raylib, its version stands for its source
+    cache.driver_hash = 14695981039346656037ull;
+    HashString(cache.driver_hash, (char const*)glGetString(GL_VENDOR));
+    HashString(cache.driver_hash, (char const*)glGetString(GL_RENDERER));
+    HashString(cache.driver_hash, (char const*)glGetString(GL_VERSION));
+    HashString(cache.driver_hash, RAYLIB_VERSION);
+    cache.is_supported = true;
+}
+
+Shader LoadCachedShader(ShaderCache const& cache, char const* fs_filepath)
+{
+    if (!cache.is_supported) {
+        return LoadShader(nullptr, fs_filepath);
+    }
+    char* source = LoadFileText(fs_filepath);
+    if (!source) {
+        return LoadShader(nullptr, fs_filepath); // Falls back to the default shader, with raylib's warning
+    }
+    uint64_t key = cache.driver_hash;
+    HashString(key, source);
+
+    std::string cache_filepath = GetCachePath(cache, fs_filepath);
+    try {
+        if (unsigned int program = LoadProgramBinary(cache_filepath, key)) {
+            UnloadFileText(source);
+            return MakeShader(program);
+        }
+    }
+    catch(std::exception& e) {
+        std::println("{}", e.what());
+    }
+
+    Shader shader = LoadShaderFromMemory(nullptr, source);
+    UnloadFileText(source);
+    if (shader.id == rlGetShaderIdDefault()) { // Didn't compile, nothing to cache
+        return shader;
+    }
+    try {
+        SaveProgramBinary(cache_filepath, key, shader.id);
+    }
+    catch(std::exception& e) {
+        std::println("{}", e.what());
+    }
+    return shader;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "raylib.h"
+#include <cstdint>
+#include <string>
+
+#define SHADER_CACHE_MAGIC "IMSC"
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_EXTENSION ".bin"
+#define SHADER_CACHE_DIRECTORY "ShaderCache"
+
+struct ShaderCacheFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key; // Of the driver and the shader sources the program was linked from
+    uint32_t format; // Binary format, as given by the driver
+    uint32_t length; // Of the binary that follows
+};
+
+// Linked shader programs saved to disk, so later launches skip compiling and linking them.
+// A cached program is only used if it was linked by the same driver, from the same sources, and the
+// driver still accepts it; otherwise the shader is compiled from source and the cache rewritten.
+// Needs glGetProgramBinary (OpenGL 4.1 or ARB_get_program_binary) and a driver with at least one
+// binary format, does nothing but compile from source without them.
+struct ShaderCache {
+    std::string directory; // Empty to disable the cache
+    bool is_supported = false;
+    uint64_t driver_hash = 0; // Of the GL vendor, renderer and version strings, and of raylib's version
+};
+
+// After the window is created
+void InitShaderCache(ShaderCache& cache, std::string const& directory);
+// Like LoadShader(nullptr, fs_filepath): raylib's default vertex shader with the fragment shader of the file
+Shader LoadCachedShader(ShaderCache const& cache, char const* fs_filepath);
@@ -0,0 +1,601 @@
+#include "simulation.h"
+#include "raymath.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<SimulationState>, "Snapshots copy the state as a block");
+
+// Same test as raylib's CheckCollisionRecs, kept here so the simulation doesn't link raylib
+static bool CheckRectsOverlap(Rectangle a, Rectangle b)
+{
+    return a.x < b.x + b.width && a.x + a.width > b.x && a.y < b.y + b.height && a.y + a.height > b.y;
+}
+
+Simulation::Simulation(LevelStream& stream, float game_width, float game_height)
+    : game_width(game_width)
+    , game_height(game_height)
+    , stream(stream)
+{
+    camera = {
+        .offset = { 0.0f, 0.0f },
+        .target = { -game_width, -game_height * 0.5f },
+        .rotation = 0.0f,
+        .zoom = 1.0f,
+    };
+
+    player = {
+        .alive = true,
+        .can_move = true,
+        .pos = { -game_width * 0.5f, game_height * 0.15f },
+        .velocity = { 360.0f, 360.0f },
+    };
+
+    InitBulletPool(bullets, BULLET_POOL_CAPACITY, BULLET_POOL_MAX_CAPACITY);
+    InitSnapshotRing(history, SIM_SNAPSHOT_COUNT);
+
+    for (auto& pos : tail) {
+        pos = player.pos;
+    }
+    SnapInterpolation();
+}
+
+void Simulation::Restart()
+{
+    is_paused = false;
+    show_debug_overlay = false;
+    level_end_reached = false;
+    start_new_level = true;
+    can_progress = false;
+    cooldown_time = 0.4f;
+    kills = 0;
+    active_entities = 0;
+    spawn_cursor = 0;
+    first_active = 0;
+    invincibility_time = INVINCIBILITY_TIME_MAX;
+    warmup_time = WARMUP_TIME_MAX;
+    score = 0;
+    progress_ticks = 0;
+    multiplicator = MULTIPLICATOR_MIN;
+    strike_time = 0.0f;
+    hits_taken = 0;
+    player = {
+        .alive = true,
+        .can_move = false,
+        .pos = { -game_width * 0.75f, 0.0f },
+        .velocity = { 360.0f, 360.0f },
+    };
+    // Enemies are set up as they get activated, so there is nothing to reset however long the level is
+    stream.Restart();
+    stream_ended = false;
+    stream_x_end = -INFINITY;
+    spawn_base = 0;
+    spawns.clear();
+    enemies.clear();
+    ClearBulletPool(bullets);
+    ClearSnapshotRing(history);
+    camera = {
+        .offset = { 0.0f, 0.0f },
+        .target = { -game_width - 0.5f * PIXEL_PER_UNIT, -game_height * 0.5f },
+        .rotation = 0.0f,
+        .zoom = 1.0f,
+    };
+    SnapInterpolation();
+}
+
+void Simulation::Step(Inputs const& inputs)
+{
+    bool in_gameplay = !just_booted && !start_new_level && !level_end_reached && !is_paused;
+    if (inputs.rewind && in_gameplay && PopSnapshot(history, *this)) {
+        return;
+    }
+
+    tick++;
+    previous_camera_target = camera.target;
+    previous_player_pos = player.pos;
+
+    if (inputs.pause) {
+        is_paused = !is_paused;
+        if (!is_paused) {
+            warmup_time = 3.0f;
+        }
+    }
+    if (inputs.debug_overlay) {
+        show_debug_overlay = !show_debug_overlay;
+    }
+
+    // The title screen scrolls on without drawing the level, it would stream all of it in
+    if (!just_booted) {
+        StreamSpawnsUpTo(abs(camera.target.x));
+        if (abs(camera.target.x) > level_length) {
+            level_end_reached = true;
+        }
+    }
+
+    if (just_booted) {
+        if (inputs.start) {
+            just_booted = false;
+            Restart();
+        }
+        ScrollCutscene();
+    }
+    else if (start_new_level) {
+        StepLevelStart();
+    }
+    else if (level_end_reached) {
+        StepLevelEnd(inputs);
+    }
+    else if (!is_paused) {
+        StepGameplay(inputs);
+        if (tick % SIM_SNAPSHOT_INTERVAL == 0) {
+            PushSnapshot(history, *this);
+        }
+    }
+}
+
+void Simulation::StepLevelStart()
+{
+    if (level_start_needs_entry) {
+        target_start_cutscene = { game_width * 0.5f, game_height * 0.5f };
+        target_end_cutscene = { game_width * 0.25f + 0.5f * PIXEL_PER_UNIT, game_height * 0.5f };
+        player.pos = target_start_cutscene + camera.target;
+        SnapInterpolation();
+        level_start_needs_entry = false;
+    }
+
+    level_start_velocity += LEVEL_START_ACCELERATION * SIM_DT;
+    if (MovePlayerToward(target_end_cutscene, level_start_velocity * SIM_DT)) {
+        start_new_level = false;
+        level_start_needs_entry = true;
+        level_start_velocity = 0.0f;
+        camera.target = { -game_width - 0.5f * PIXEL_PER_UNIT, -game_height * 0.5f };
+        player.pos = { -game_width * 0.75f, 0.0f };
+        SnapInterpolation();
+    }
+
+    ScrollCutscene();
+}
+
+void Simulation::StepLevelEnd(Inputs const& inputs)
+{
+    if (level_end_needs_entry) {
+        target_start_cutscene = { game_width * 0.25f, game_height * 0.5f };
+        target_end_cutscene = { game_width * 0.75f, game_height * 0.5f };
+        strike_time = 0.3f;
+        level_end_needs_entry = false;
+    }
+
+    if (strike_time > 0.0f) {
+        strike_time -= SIM_DT;
+        if (strike_time <= 0.0f) {
+            strike_time = 0.0f;
+        }
+    }
+
+    player.can_move = false;
+    invincibility_time = 0.0f;
+
+    if (inputs.start) {
+        will_restart = true;
+        show_restart_help = false;
+    }
+
+    ScrollCutscene();
+
+    if (!will_restart && !level_end_in_place && MovePlayerToward(target_start_cutscene, 150.0f * SIM_DT)) {
+        level_end_in_place = true;
+        show_restart_help = true;
+    }
+    else if (will_restart && level_end_in_place) {
+        level_end_velocity += LEVEL_END_ACCELERATION * SIM_DT;
+        if (MovePlayerToward(target_end_cutscene, level_end_velocity * SIM_DT)) {
+            player.pos.y = -999.0f;
+            level_end_in_place = false;
+            will_restart = false;
+            level_end_needs_entry = false;
+            level_end_velocity = 0.0f;
+            Restart();
+        }
+    }
+}
+
+void Simulation::StepGameplay(Inputs const& inputs)
+{
+    elapsed_time += SIM_DT;
+
+    if (inputs.reset) {
+        Restart();
+    }
+
+    if (warmup_time > 0.0f) {
+        player.can_move = false;
+        warmup_time -= SIM_DT;
+        if (warmup_time < 0.0f) {
+            warmup_time = 0.0f;
+            can_progress = true;
+            player.can_move = true;
+        }
+    }
+
+    if (cooldown_time > 0.0f && warmup_time <= 0.0f) {
+        cooldown_time -= SIM_DT;
+        if (cooldown_time <= 0.0f) {
+            cooldown_time = 0.0f;
+        }
+    }
+
+    if (invincibility_time > 0.0f && warmup_time <= 0.0f) {
+        invincibility_time -= SIM_DT;
+        if (invincibility_time <= 0.0f) {
+            invincibility_time = 0.0f;
+        }
+    }
+
+    if (strike_time > 0.0f && warmup_time <= 0.0f) {
+        strike_time -= SIM_DT;
+        if (strike_time <= 0.0f) {
+            strike_time = 0.0f;
+        }
+    }
+
+    if (inputs.stop) {
+        can_progress = !can_progress;
+    }
+
+    // The step is fixed, so the scroll is exactly PIXEL_PER_SECOND without rounding to whole pixels:
+    // rendering interpolates the camera instead
+    float progression = 0.0f;
+    if (can_progress && warmup_time <= 0.0f) {
+        progression = SIM_DT * PIXEL_PER_SECOND;
+        progress_ticks++;
+    }
+
+    camera.offset.x += inputs.pan;
+    camera.target.x += progression;
+
+    player.pos.x += progression;
+
+    if (player.can_move) {
+        player.pos.x += SIM_DT * player.velocity.x * inputs.dir.x;
+        player.pos.y += SIM_DT * player.velocity.y * inputs.dir.y;
+    }
+    player.pos.x = Clamp(player.pos.x, camera.target.x, camera.target.x + game_width);
+    player.pos.y = Clamp(player.pos.y, camera.target.y, camera.target.y + game_height);
+
+    UpdateTail();
+
+    for (int i = 0; i < 4; i++) {
+        tail[i].x += progression;
+    }
+
+    Rectangle player_rect = GetBoundingBox(player.pos.x, player.pos.y, PLAYER_SIZE, PLAYER_SIZE);
+
+    if (inputs.fire && cooldown_time <= 0.0f) {
+        cooldown_time = 0.12f;
+        CreateBullet(bullets, { player.pos.x + PLAYER_SIZE * 0.5f, player.pos.y }, { BULLET_FRIEND_SPEED, 0.0f }, BULLET_FRIEND);
+    }
+
+    BeginProfilePhase(profiler, ProfilePhase::Spawns);
+    // Enemies are sorted by spawn x: activate the ones the camera reaches...
+    StreamSpawnsUpTo(camera.target.x + game_width + ENEMY_SIZE * 0.5f);
+    while (spawn_cursor < SpawnsReceived() && Spawn(spawn_cursor).x - ENEMY_SIZE * 0.5f < camera.target.x + game_width) {
+        LevelSpawn const& spawn = Spawn(spawn_cursor);
+        Enemy(spawn_cursor) = {
+            .alive = true,
+            .can_move = true,
+            .pos = { spawn.x, spawn.y },
+            .type = spawn.type,
+            .hp = spawn.hp,
+            .hp_max = spawn.hp,
+            .last_hit_time = 0.0f,
+            .last_fire_time = ENEMY_FIRE_TIME_MAX,
+        };
+        spawn_cursor++;
+    }
+    // ...and retire the ones it left behind
+    while (first_active < spawn_cursor && Spawn(first_active).x <= camera.target.x) {
+        Enemy(first_active).can_move = false;
+        first_active++;
+    }
+    DropPassedSpawns();
+    EndProfilePhase(profiler, ProfilePhase::Spawns);
+
+    BeginProfilePhase(profiler, ProfilePhase::Enemies);
+    // Broad phase: friendly bullets bucketed over the camera window, so each enemy only tests the ones nearby
+    grid_items.clear();
+    EntityStore& bullet_store = bullets.store;
+    for (int j : bullets.alive_slots) {
+        if (bullet_store.cold[j].type == BULLET_FRIEND) {
+            grid_items.push_back({ j, GetBoundingBox(bullet_store.pos_x[j], bullet_store.pos_y[j], BULLET_SIZE_X, BULLET_SIZE_Y) });
+        }
+    }
+    BuildCollisionGrid(bullet_grid, Rectangle{ camera.target.x, camera.target.y, game_width, game_height }, COLLISION_CELL_SIZE, grid_items);
+
+    FindContacts(player_rect);
+
+    // Applied in order: the first enemy a bullet reaches takes it, like kills and hits update the score
+    active_entities = 0;
+    for (size_t i = first_active; i < spawn_cursor; i++) {
+        Entity& enemy = Enemy(i);
+        if (!enemy.alive)
+            continue;
+        active_entities++;
+
+        EnemyContacts const& contact = contacts[i - first_active];
+        if (invincibility_time <= 0.0f && contact.player) {
+            HitPlayer();
+        }
+
+        if (enemy.type == ENEMY_SHOOTER && elapsed_time - enemy.last_fire_time >= ENEMY_FIRE_TIME_MAX) {
+            enemy.last_fire_time = elapsed_time;
+            CreateBullet(bullets, { enemy.pos.x - ENEMY_SIZE * 0.5f, enemy.pos.y }, { -BULLET_FOE_SPEED, 0.0f }, BULLET_FOE);
+        }
+
+        std::vector<int> const& range_bullets = contact_ranges[(i - first_active) / CONTACT_JOB_GRAIN].bullets;
+        for (uint32_t k = 0; k < contact.nbullets; k++) {
+            int j = range_bullets[contact.first_bullet + k];
+            if (bullet_store.alive[j] && bullet_store.cold[j].type == BULLET_FRIEND) { // May have changed earlier this step
+                if (enemy.type == ENEMY_DEFLECT && elapsed_time - enemy.last_hit_time >= ENEMY_DEFLECT_TIME_MAX) {
+                    enemy.last_hit_time = elapsed_time;
+                    bullet_store.vel_y[j] = (bullet_store.pos_y[j] - enemy.pos.y) * 2.0f;
+                    bullet_store.vel_x[j] = -BULLET_FOE_SPEED;
+                    bullet_store.cold[j].type = BULLET_FOE;
+                }
+                else if (enemy.type == ENEMY_SHIELD && elapsed_time - enemy.last_hit_time >= ENEMY_SHIELD_TIME_MAX) {
+                    enemy.last_hit_time = elapsed_time;
+                    bullet_store.alive[j] = 0;
+                }
+                else {
+                    bullet_store.alive[j] = 0;
+                    enemy.hp--;
+                    if (enemy.hp <= 0) {
+                        enemy.alive = false;
+                        kills++;
+                        score += int(multiplicator * enemy.hp_max * 100);
+                        multiplicator += 0.1f;
+                        strike_time = 0.3f;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    EndProfilePhase(profiler, ProfilePhase::Enemies);
+
+    BeginProfilePhase(profiler, ProfilePhase::Bullets);
+    // Movement and off screen culling run over every slot as vector kernels, released slots don't move
+    for (size_t i = 0; i < bullets.alive_slots.size();) {
+        int slot = bullets.alive_slots[i];
+        if (!bullet_store.alive[slot]) { // Hit this step
+            ReleaseBullet(bullets, slot); // Moves the last alive bullet to i
+            continue;
+        }
+        i++;
+    }
+    IntegrateEntities(bullet_store, SIM_DT);
+    CullEntitiesOutsideX(bullet_store, camera.target.x, camera.target.x + game_width, 5.0f);
+    for (size_t i = 0; i < bullets.alive_slots.size();) {
+        int slot = bullets.alive_slots[i];
+        if (!bullet_store.alive[slot]) {
+            ReleaseBullet(bullets, slot); // Moves the last alive bullet to i
+            continue;
+        }
+        if (bullet_store.cold[slot].type == BULLET_FOE) {
+            Rectangle bullet_rect = GetBoundingBox(bullet_store.pos_x[slot], bullet_store.pos_y[slot], BULLET_SIZE_X, BULLET_SIZE_Y);
+            if (invincibility_time <= 0.0f && CheckRectsOverlap(player_rect, bullet_rect)) {
+                HitPlayer();
+            }
+        }
+        i++;
+    }
+    EndProfilePhase(profiler, ProfilePhase::Bullets);
+}
+
+bool Simulation::IsProgressing() const
+{
+    return !just_booted && !start_new_level && !level_end_reached && !is_paused && can_progress && warmup_time <= 0.0f;
+}
+
+std::pair<size_t, size_t> Simulation::FindSpawnsBetween(float min_x, float max_x) const
+{
+    auto first = std::ranges::partition_point(spawns, [&](LevelSpawn const& spawn) { return spawn.x <= min_x; });
+    auto last = std::ranges::partition_point(first, spawns.end(), [&](LevelSpawn const& spawn) { return spawn.x < max_x; });
+    return { spawn_base + size_t(first - spawns.begin()), spawn_base + size_t(last - spawns.begin()) };
+}
+
+void Simulation::FindContacts(Rectangle player_rect)
+{
+    size_t nactive = spawn_cursor - first_active;
+    contacts.resize(nactive);
+    size_t nranges = (nactive + CONTACT_JOB_GRAIN - 1) / CONTACT_JOB_GRAIN;
+    if (contact_ranges.size() < nranges) {
+        contact_ranges.resize(nranges);
+    }
+    EntityStore const& bullet_store = bullets.store;
+    ParallelFor(jobs, nactive, CONTACT_JOB_GRAIN, [&](size_t begin, size_t end) {
+        ContactRange& range = contact_ranges[begin / CONTACT_JOB_GRAIN];
+        range.bullets.clear();
+        for (size_t k = begin; k < end; k++) {
+            Entity const& enemy = Enemy(first_active + k);
+            EnemyContacts& contact = contacts[k];
+            contact = { false, uint32_t(range.bullets.size()), 0 };
+            if (!enemy.alive) {
+                continue;
+            }
+            Rectangle enemy_rect = GetBoundingBox(enemy.pos.x, enemy.pos.y, ENEMY_SIZE, ENEMY_SIZE);
+            contact.player = CheckRectsOverlap(player_rect, enemy_rect);
+            QueryCollisionGrid(bullet_grid, enemy_rect, range.nearby_bullets);
+            for (int j : range.nearby_bullets) {
+                Rectangle bullet_rect = GetBoundingBox(bullet_store.pos_x[j], bullet_store.pos_y[j], BULLET_SIZE_X, BULLET_SIZE_Y);
+                if (CheckRectsOverlap(bullet_rect, enemy_rect)) {
+                    range.bullets.push_back(j);
+                }
+            }
+            contact.nbullets = uint32_t(range.bullets.size()) - contact.first_bullet;
+        }
+    });
+}
+
+void Simulation::StreamSpawnsUpTo(float x)
+{
+    while (!stream_ended && stream_x_end <= x) {
+        LevelChunk const& chunk = stream.Receive();
+        spawns.insert(spawns.end(), chunk.spawns.begin(), chunk.spawns.end());
+        stream_x_end = chunk.x_end;
+        stream_ended = chunk.last;
+        if (chunk.last) {
+            level_length = chunk.length;
+        }
+        stream.Release(chunk);
+    }
+    enemies.resize(spawns.size());
+}
+
+void Simulation::DropPassedSpawns()
+{
+    size_t keep = first_active;
+    if (history.count) {
+        size_t oldest = (history.next + history.snapshots.size() - history.count) % history.snapshots.size();
+        keep = std::min(keep, history.snapshots[oldest].state.first_active);
+    }
+    while (spawn_base < keep) {
+        spawns.pop_front();
+        enemies.pop_front();
+        spawn_base++;
+    }
+}
+
+// Title screen and cutscenes scroll faster than the level
+void Simulation::ScrollCutscene()
+{
+    float progression = SIM_DT * CUTSCENE_SCROLL_SPEED;
+    camera.target.x += progression;
+    player.pos.x += progression;
+    UpdateTail();
+}
+
+void Simulation::UpdateTail()
+{
+    if (tail_time > 0.0f) {
+        tail_time -= SIM_DT;
+        if (tail_time <= 0.0f) {
+            tail_time = TAIL_TIME_DEF;
+            tail[itail] = player.pos;
+            itail = (itail + 1) % 4;
+        }
+    }
+}
+
+bool Simulation::MovePlayerToward(Vector2 target, float distance)
+{
+    if (!Vector2Equals(player.pos, target + camera.target)) {
+        player.pos = Vector2MoveTowards(player.pos, target + camera.target, distance);
+        return false;
+    }
+    return true;
+}
+
+void Simulation::HitPlayer()
+{
+    invincibility_time = INVINCIBILITY_TIME_MAX;
+    player.hp--;
+    hits_taken++;
+    multiplicator = MULTIPLICATOR_MIN;
+    strike_time = 0.3f;
+}
+
+void Simulation::SnapInterpolation()
+{
+    previous_camera_target = camera.target;
+    previous_player_pos = player.pos;
+}
+
+void SaveSnapshot(Simulation const& sim, SimulationSnapshot& snapshot)
+{
+    snapshot.state = sim;
+    snapshot.enemies.assign(sim.enemies.begin() + (sim.first_active - sim.spawn_base), sim.enemies.begin() + (sim.spawn_cursor - sim.spawn_base));
+    snapshot.bullets = sim.bullets; // Reuses the snapshot buffers when they are big enough
+}
+
+void RestoreSnapshot(Simulation& sim, SimulationSnapshot const& snapshot)
+{
+    static_cast<SimulationState&>(sim) = snapshot.state;
+    std::ranges::copy(snapshot.enemies, sim.enemies.begin() + (sim.first_active - sim.spawn_base));
+    sim.bullets = snapshot.bullets;
+}
+
+void InitSnapshotRing(SnapshotRing& ring, size_t capacity)
+{
+    ring.snapshots.resize(capacity);
+    ClearSnapshotRing(ring);
+}
+
+void ClearSnapshotRing(SnapshotRing& ring)
+{
+    ring.next = 0;
+    ring.count = 0;
+}
+
+void PushSnapshot(SnapshotRing& ring, Simulation const& sim)
+{
+    SaveSnapshot(sim, ring.snapshots[ring.next]);
+    ring.next = (ring.next + 1) % ring.snapshots.size();
+    ring.count = std::min(ring.count + 1, ring.snapshots.size());
+}
+
+bool PopSnapshot(SnapshotRing& ring, Simulation& sim)
+{
+    if (!ring.count) {
+        return false;
+    }
+    ring.next = (ring.next + ring.snapshots.size() - 1) % ring.snapshots.size();
+    ring.count--;
+    RestoreSnapshot(sim, ring.snapshots[ring.next]);
+    return true;
+}
+
+void AccumulateInputs(Inputs& pending, Inputs const& polled)
+{
+    pending.dir = polled.dir;
+    pending.fire = polled.fire;
+    pending.rewind = polled.rewind;
+    pending.start |= polled.start;
+    pending.pause |= polled.pause;
+    pending.reset |= polled.reset;
+    pending.pan += polled.pan;
+    pending.stop |= polled.stop;
+    pending.debug_overlay |= polled.debug_overlay;
+    pending.fullscreen |= polled.fullscreen;
+}
+
+void ConsumeInputPresses(Inputs& pending)
+{
+    pending.start = false;
+    pending.pause = false;
+    pending.reset = false;
+    pending.pan = 0.0f;
+    pending.stop = false;
+    pending.debug_overlay = false;
+    pending.fullscreen = false;
+}
+
+Rectangle GetBoundingBox(float cx, float cy, float width, float height)
+{
+    float x = cx - width * 0.5f;
+    float y = cy - height * 0.5f;
+    return Rectangle{x, y, width, height};
+}
+
+void CreateBullet(BulletPool& bullets, Vector2 pos, Vector2 velocity, int type)
+{
+    int slot = AcquireBullet(bullets);
+    if (slot < 0) {
+        return;
+    }
+    EntityStore& store = bullets.store;
+    store.pos_x[slot] = pos.x;
+    store.pos_y[slot] = pos.y;
+    store.vel_x[slot] = velocity.x;
+    store.vel_y[slot] = velocity.y;
+    store.cold[slot].type = type;
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include "bullet_pool.h"
+#include "collision_grid.h"
+#include "entity.h"
+#include "job_system.h"
+#include "level_stream.h"
+#include "profiler.h"
+#include "raylib.h"
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#define SIM_TICK_RATE 60 // Gameplay steps per second, independent of the render rate
+#define SIM_DT (1.0f / SIM_TICK_RATE)
+#define SIM_GAME_WIDTH 800.0f
+#define SIM_GAME_HEIGHT 450.0f
+#define SIM_MAX_FRAME_TIME 0.25f // Longer frames are clamped so a stall doesn't trigger a burst of steps
+#define SIM_SNAPSHOT_INTERVAL 4 // Steps between two rewind snapshots
+#define SIM_SNAPSHOT_COUNT 150 // 10 seconds of rewind
+
+#define WARMUP_TIME_MAX 3.1f
+#define INVINCIBILITY_TIME_MAX 1.5f
+#define ENEMY_SHIELD_TIME_MAX 1.0f
+#define ENEMY_FIRE_TIME_MAX 2.0f
+#define ENEMY_DEFLECT_TIME_MAX 1.0f
+#define MULTIPLICATOR_MIN 1.0f
+#define TAIL_TIME_DEF 0.1f
+
+#define CUTSCENE_SCROLL_SPEED 300.0f
+#define LEVEL_START_ACCELERATION 200.0f
+#define LEVEL_END_ACCELERATION 300.0f
+
+#define PLAYER_SIZE 30.0f
+#define ENEMY_SIZE 20.0f
+#define BULLET_SIZE_X 10.0f
+#define BULLET_SIZE_Y 5.0f
+#define DEFLECT_SIZE 30.0f
+#define COLLISION_CELL_SIZE 50.0f
+#define CONTACT_JOB_GRAIN 32 // Enemies per narrow phase job
+
+#define ENEMY_SHIELD 2
+#define ENEMY_SHOOTER 3
+#define ENEMY_DEFLECT 4
+
+#define BULLET_FRIEND 0
+#define BULLET_FOE 1
+
+#define BULLET_FRIEND_SPEED 1000.0f
+#define BULLET_FOE_SPEED 100.0f
+#define BULLET_POOL_CAPACITY 64
+#define BULLET_POOL_MAX_CAPACITY 4096
+
+struct Inputs {
+    Vector2 dir;
+    bool start;
+    bool pause;
+    bool fire;
+    bool reset;
+    float pan;
+    bool stop;
+    bool debug_overlay;
+    bool fullscreen;
+    bool rewind;
+};
+
+// Folds the inputs polled in a frame into the ones waiting for the next step: held controls take
+// the latest state, presses stay set until a step consumes them, so none is lost or repeated
+// whatever the number of steps run in the frame.
+void AccumulateInputs(Inputs& pending, Inputs const& polled);
+void ConsumeInputPresses(Inputs& pending);
+
+// Gameplay state that fits in a flat block: saving or restoring it is a plain copy.
+// The state of the enemies and bullets is kept apart, see SimulationSnapshot.
+struct SimulationState {
+    uint64_t tick = 0;
+    float elapsed_time = 0.0f; // Gameplay time, stops with pauses and cutscenes
+    uint64_t progress_ticks = 0; // Steps the level scrolled since it started, the music is at progress_ticks * SIM_DT
+
+    Camera2D camera;
+    Entity player;
+
+    // Where the camera and the player were before the last step
+    Vector2 previous_camera_target;
+    Vector2 previous_player_pos;
+
+    Vector2 tail[4];
+    int itail = 0;
+    float tail_time = TAIL_TIME_DEF;
+
+    bool just_booted = true;
+    bool is_paused = false;
+    bool show_debug_overlay = false;
+    bool level_end_reached = false;
+    bool start_new_level = false;
+    bool can_progress = false;
+    bool show_restart_help = false;
+    bool will_restart = false;
+    float cooldown_time = 0.4f;
+    int kills = 0;
+    int active_entities = 0;
+    size_t spawn_cursor = 0; // Next enemy of the spawn stream to enter the screen
+    size_t first_active = 0; // Enemies before it have scrolled off screen
+    float invincibility_time = INVINCIBILITY_TIME_MAX;
+    float warmup_time = WARMUP_TIME_MAX;
+    int score = 0;
+    float multiplicator = MULTIPLICATOR_MIN;
+    float strike_time = 0.0f;
+    int hits_taken = 0;
+
+    Vector2 target_start_cutscene = {};
+    Vector2 target_end_cutscene = {};
+    float level_start_velocity = 0.0f;
+    bool level_start_needs_entry = true;
+    float level_end_velocity = 0.0f;
+    bool level_end_needs_entry = true;
+    bool level_end_in_place = false;
+};
+
+// Everything needed to put a simulation back where it was. Enemies past the spawn cursor are set
+// up when they get activated, and the ones before first_active can't change anymore, so only the
+// active window is kept.
+struct SimulationSnapshot {
+    SimulationState state;
+    std::vector<Entity> enemies; // From state.first_active to state.spawn_cursor
+    BulletPool bullets;
+};
+
+// Recent snapshots, oldest overwritten first. Slots keep their buffers, so once warm pushing a
+// snapshot doesn't allocate.
+struct SnapshotRing {
+    std::vector<SimulationSnapshot> snapshots;
+    size_t next = 0; // Slot of the next push
+    size_t count = 0;
+};
+
+// What an enemy touches at the start of the collision pass
+struct EnemyContacts {
+    bool player;
+    uint32_t first_bullet; // Friendly bullets overlapping it, in its ContactRange
+    uint32_t nbullets;
+};
+
+// Scratch of one narrow phase job
+struct ContactRange {
+    std::vector<int> bullets;
+    std::vector<int> nearby_bullets;
+};
+
+// Every piece of gameplay state, advanced by fixed steps of SIM_DT so the outcome only depends on
+// the level and the sequence of inputs, not on the frame rate.
+// The state before the last step is kept for the few things drawn in motion, so rendering can
+// interpolate between the two.
+struct Simulation : SimulationState {
+    // The stream must outlive the simulation
+    Simulation(LevelStream& stream, float game_width, float game_height);
+
+    void Step(Inputs const& inputs);
+    void Restart();
+    // Whether the next step scrolls the level, the only steps the music is played along with
+    bool IsProgressing() const;
+
+    // Spawn and enemy by index in the level, from spawn_base to spawn_base + spawns.size()
+    LevelSpawn const& Spawn(size_t i) const { return spawns[i - spawn_base]; }
+    Entity& Enemy(size_t i) { return enemies[i - spawn_base]; }
+    Entity const& Enemy(size_t i) const { return enemies[i - spawn_base]; }
+    size_t SpawnsReceived() const { return spawn_base + spawns.size(); }
+    // Level indices [first, last) of the received spawns with min_x < x < max_x. Enemies don't move
+    // from their spawn, so this is also where the enemies in an x range are.
+    std::pair<size_t, size_t> FindSpawnsBetween(float min_x, float max_x) const;
+
+    float game_width;
+    float game_height;
+    float level_length = INFINITY; // Known once the stream has ended
+
+    LevelStream& stream;
+    bool stream_ended = false;
+    float stream_x_end = -INFINITY; // Every spawn before it has been received
+    size_t spawn_base = 0; // Index in the level of spawns.front()
+    // Pulled from the stream as the camera gets to them, dropped once behind both the camera and
+    // the oldest snapshot. Sorted by x.
+    std::deque<LevelSpawn> spawns;
+    std::deque<Entity> enemies; // Indexed like spawns, only valid before spawn_cursor
+    BulletPool bullets;
+    // Taken every SIM_SNAPSHOT_INTERVAL steps. Holding rewind during gameplay steps back through them,
+    // at SIM_SNAPSHOT_INTERVAL times the speed.
+    SnapshotRing history;
+    // Runs the narrow phase of the collisions, everything runs on the calling thread when null.
+    // The job results are applied in enemy order, so the outcome doesn't depend on the thread count.
+    JobSystem* jobs = nullptr;
+    Profiler* profiler = nullptr; // Times the phases of the steps when set
+
+    // Collision scratch, rebuilt every step
+    CollisionGrid bullet_grid;
+    std::vector<GridItem> grid_items;
+    std::vector<EnemyContacts> contacts; // From first_active to spawn_cursor
+    std::vector<ContactRange> contact_ranges; // One per CONTACT_JOB_GRAIN enemies
+
+private:
+    // Receives chunks until every spawn before x is in, blocks if the stream lags behind
+    void StreamSpawnsUpTo(float x);
+    // Drops the spawns no snapshot can bring back
+    void DropPassedSpawns();
+    void StepLevelStart();
+    void StepLevelEnd(Inputs const& inputs);
+    void StepGameplay(Inputs const& inputs);
+    // Finds what each active enemy touches, only reads the state
+    void FindContacts(Rectangle player_rect);
+    void ScrollCutscene();
+    void UpdateTail();
+    bool MovePlayerToward(Vector2 target, float distance);
+    void HitPlayer();
+    // Skips interpolation across a teleport
+    void SnapInterpolation();
+};
+
+void SaveSnapshot(Simulation const& sim, SimulationSnapshot& snapshot);
+void RestoreSnapshot(Simulation& sim, SimulationSnapshot const& snapshot);
+
+void InitSnapshotRing(SnapshotRing& ring, size_t capacity);
+void ClearSnapshotRing(SnapshotRing& ring);
+void PushSnapshot(SnapshotRing& ring, Simulation const& sim);
+// Restores the latest snapshot and drops it, returns false when the ring is empty
+bool PopSnapshot(SnapshotRing& ring, Simulation& sim);
+
+Rectangle GetBoundingBox(float cx, float cy, float width, float height);
+void CreateBullet(BulletPool& bullets, Vector2 pos, Vector2 velocity, int type);
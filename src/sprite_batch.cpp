@@ -0,0 +1,61 @@
+#include "sprite_batch.h"
+#include "rlgl.h"
+#include <algorithm>
+
+void BatchRectangle(SpriteBatch& batch, int x, int y, int width, int height, Color color)
+{
+    batch.quads.push_back({ Rectangle{ float(x), float(y), float(width), float(height) }, color, color });
+}
+
+void BatchRectangleGradientH(SpriteBatch& batch, int x, int y, int width, int height, Color left, Color right)
+{
+    batch.quads.push_back({ Rectangle{ float(x), float(y), float(width), float(height) }, left, right });
+}
+
+void FlushSpriteBatch(SpriteBatch& batch)
+{
+    if (batch.quads.empty()) {
+        return;
+    }
+    Texture2D shapes = GetShapesTexture();
+    Rectangle source = GetShapesTextureRectangle();
+    float u0 = source.x / shapes.width;
+    float v0 = source.y / shapes.height;
+    float u1 = (source.x + source.width) / shapes.width;
+    float v1 = (source.y + source.height) / shapes.height;
+
+    rlSetTexture(shapes.id);
+    for (size_t first = 0; first < batch.quads.size(); first += SPRITE_BATCH_QUADS_PER_BEGIN) {
+        size_t last = std::min(first + SPRITE_BATCH_QUADS_PER_BEGIN, batch.quads.size());
+        rlCheckRenderBatchLimit(int(4 * (last - first))); // Draws what is pending if they don't fit
+        rlBegin(RL_QUADS);
+            rlNormal3f(0.0f, 0.0f, 1.0f);
+            for (size_t i = first; i < last; i++) {
+                SpriteQuad const& quad = batch.quads[i];
+                Rectangle const& rect = quad.rect;
+                // Top left, bottom left, bottom right, top right, like DrawRectanglePro
+                rlColor4ub(quad.left.r, quad.left.g, quad.left.b, quad.left.a);
+                rlTexCoord2f(u0, v0);
+                rlVertex2f(rect.x, rect.y);
+                rlTexCoord2f(u0, v1);
+                rlVertex2f(rect.x, rect.y + rect.height);
+                rlColor4ub(quad.right.r, quad.right.g, quad.right.b, quad.right.a);
+                rlTexCoord2f(u1, v1);
+                rlVertex2f(rect.x + rect.width, rect.y + rect.height);
+                rlTexCoord2f(u1, v0);
+                rlVertex2f(rect.x + rect.width, rect.y);
+            }
+        rlEnd();
+    }
+    rlSetTexture(0);
+
+    batch.quads_drawn += int(batch.quads.size());
+    batch.flushes++;
+    batch.quads.clear();
+}
+
+void ResetSpriteBatchCounters(SpriteBatch& batch)
+{
+    batch.quads_drawn = 0;
+    batch.flushes = 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "raylib.h"
+#include <vector>
+
+#define SPRITE_BATCH_QUADS_PER_BEGIN 1024 // Quads emitted between two render batch limit checks
+
+// Solid rectangle, shaded from left to right
+struct SpriteQuad {
+    Rectangle rect;
+    Color left;
+    Color right;
+};
+
+// Solid rectangles collected over a pass and handed to rlgl in one go, instead of one
+// DrawRectangle call each. The vertices are the ones DrawRectangle and DrawRectangleGradientH emit,
+// on the same shapes texture, so the output doesn't change; rlgl still merges them into as few
+// draw calls as its buffer allows.
+// Quads are drawn in the order they are added: flush before drawing anything else on top.
+struct SpriteBatch {
+    std::vector<SpriteQuad> quads;
+    int quads_drawn = 0; // Since the last reset of the counters
+    int flushes = 0;
+};
+
+// Same arguments as DrawRectangle
+void BatchRectangle(SpriteBatch& batch, int x, int y, int width, int height, Color color);
+// Same arguments as DrawRectangleGradientH
+void BatchRectangleGradientH(SpriteBatch& batch, int x, int y, int width, int height, Color left, Color right);
+void FlushSpriteBatch(SpriteBatch& batch);
+void ResetSpriteBatchCounters(SpriteBatch& batch);
@@ -0,0 +1,145 @@
+#include "bloom.h"
+#include "shader_cache.h"
+#include "raylib.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <string>
+
+// Runs from the source directory, for the shaders and the reference. Needs a display, a hidden
+// window is opened (xvfb-run on headless machines). The reference was rendered on Mesa llvmpipe,
+// which CMake forces with LIBGL_ALWAYS_SOFTWARE=1.
+#define BLOOM_TEST_WIDTH 800 // The game size
+#define BLOOM_TEST_HEIGHT 450
+#define BLOOM_TEST_REFERENCE "tests/bloom/reference.png"
+#define BLOOM_TEST_SKIPPED 77 // Return code CTest reports as skipped
+
+// The reference is the bloom of the scene below through the full resolution blur that the dual
+// filter chain replaced: the threshold then 5 horizontal and vertical passes of the 9 tap gaussian
+// of the old Assets/blur.fs, 1.5 pixels apart. Each quality has to stay this close to it.
+struct BloomTestCase {
+    BloomQuality quality;
+    float max_mean_error; // Mean of the absolute differences of every channel, in 0-255 steps
+    int max_error; // On any channel of any pixel
+    float max_energy_error; // Relative difference of the sums of every channel: how much bloom there is
+};
+
+static BloomTestCase const bloom_test_cases[] = {
+    // Loses the 1 pixel wide lines, which are under the threshold once averaged at half resolution
+    { BloomQuality::Low, 1.5f, 64, 0.03f },
+    { BloomQuality::High, 1.25f, 64, 0.005f },
+};
+
+// Bright blocks and lines of several sizes, a dim block under the threshold and two 1 pixel wide
+// lines over it, away from the edges where the old blur wrapped around
+static void DrawBloomTestScene()
+{
+    ClearBackground(BLACK);
+    DrawRectangle(100, 100, 120, 80, Color{ 255, 255, 255, 255 });
+    DrawRectangle(300, 200, 4, 150, Color{ 0, 228, 48, 255 });
+    DrawRectangle(420, 120, 200, 12, Color{ 253, 249, 0, 255 });
+    DrawRectangle(150, 300, 60, 60, Color{ 255, 109, 194, 255 });
+    DrawRectangle(520, 260, 160, 100, Color{ 60, 60, 60, 255 });
+    DrawRectangle(700, 60, 30, 30, Color{ 102, 191, 255, 255 });
+    DrawRectangle(80, 401, 400, 1, Color{ 128, 128, 128, 255 });
+    DrawRectangle(741, 150, 1, 250, Color{ 128, 128, 128, 255 });
+}
+
+// Returns whether the bloom of quality is close enough to reference, saves it to output_dir if not
+static bool TestBloomQuality(Bloom& bloom, BloomTestCase const& test, Texture2D scene, RenderTexture2D output, Image reference, std::string const& output_dir)
+{
+    ResizeBloom(bloom, BLOOM_TEST_WIDTH, BLOOM_TEST_HEIGHT, test.quality);
+    Texture2D const* bloom_texture = RenderBloom(bloom, scene);
+    // Scaled to the scene size like the game composites it
+    BeginTextureMode(output);
+        ClearBackground(BLANK);
+        DrawTexturePro(
+            *bloom_texture,
+            Rectangle{ 0, 0, float(bloom_texture->width), -float(bloom_texture->height) },
+            Rectangle{ 0, 0, float(BLOOM_TEST_WIDTH), float(BLOOM_TEST_HEIGHT) },
+            Vector2{ 0.0f, 0.0f },
+            0.0f,
+            WHITE
+        );
+    EndTextureMode();
+    Image image = LoadImageFromTexture(output.texture);
+    ImageFlipVertical(&image); // Render textures are stored bottom up
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8);
+
+    unsigned char const* actual = static_cast<unsigned char const*>(image.data);
+    unsigned char const* expected = static_cast<unsigned char const*>(reference.data);
+    int nvalues = BLOOM_TEST_WIDTH * BLOOM_TEST_HEIGHT * 3;
+    double error_sum = 0.0;
+    double actual_sum = 0.0;
+    double expected_sum = 0.0;
+    int max_error = 0;
+    for (int i = 0; i < nvalues; i++) {
+        int error = std::abs(int(actual[i]) - int(expected[i]));
+        error_sum += error;
+        max_error = std::max(max_error, error);
+        actual_sum += actual[i];
+        expected_sum += expected[i];
+    }
+    float mean_error = float(error_sum / nvalues);
+    float energy_error = float(std::abs(actual_sum - expected_sum) / expected_sum);
+    bool ok = mean_error <= test.max_mean_error && max_error <= test.max_error && energy_error <= test.max_energy_error;
+    char const* name = GetBloomQualityName(test.quality);
+    std::println("{}: {} mean error {:.3f} (max {:.3f}), max error {} (max {}), energy error {:.2f}% (max {:.2f}%)",
+        name, ok ? "ok" : "FAILED",
+        mean_error, test.max_mean_error,
+        max_error, test.max_error,
+        energy_error * 100.0f, test.max_energy_error * 100.0f);
+    if (!ok) {
+        std::string filepath = std::format("{}/bloom_{}.png", output_dir, name);
+        ExportImage(image, filepath.c_str());
+        std::println("Saved the bloom to {}", filepath);
+    }
+    UnloadImage(image);
+    return ok;
+}
+
+// Usage: imomi-bloom-test [directory where failing renders are saved]
+int main(int argc, char** argv)
+{
+    std::string output_dir = argc > 1 ? argv[1] : ".";
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(BLOOM_TEST_WIDTH, BLOOM_TEST_HEIGHT, "ImomI bloom test");
+    if (!IsWindowReady()) {
+        std::println("No display to open a window on, skipped");
+        return BLOOM_TEST_SKIPPED;
+    }
+
+    Image reference = LoadImage(BLOOM_TEST_REFERENCE);
+    if (reference.width != BLOOM_TEST_WIDTH || reference.height != BLOOM_TEST_HEIGHT) {
+        std::println("Can't load {}", BLOOM_TEST_REFERENCE);
+        CloseWindow();
+        return 1;
+    }
+    ImageFormat(&reference, PIXELFORMAT_UNCOMPRESSED_R8G8B8);
+
+    RenderTexture2D scene = LoadRenderTexture(BLOOM_TEST_WIDTH, BLOOM_TEST_HEIGHT);
+    SetTextureFilter(scene.texture, TEXTURE_FILTER_BILINEAR);
+    BeginTextureMode(scene);
+        DrawBloomTestScene();
+    EndTextureMode();
+    RenderTexture2D output = LoadRenderTexture(BLOOM_TEST_WIDTH, BLOOM_TEST_HEIGHT);
+
+    ShaderCache shader_cache;
+    InitShaderCache(shader_cache, ""); // Always from source
+    Bloom bloom;
+    LoadBloom(bloom, BLOOM_TEST_WIDTH, BLOOM_TEST_HEIGHT, BloomQuality::Off, shader_cache);
+    bool ok = true;
+    for (BloomTestCase const& test : bloom_test_cases) {
+        ok = TestBloomQuality(bloom, test, scene.texture, output, reference, output_dir) && ok;
+    }
+
+    UnloadBloom(bloom);
+    UnloadRenderTexture(output);
+    UnloadRenderTexture(scene);
+    UnloadImage(reference);
+    CloseWindow();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <print>
+
+// Test helper: counts failed checks, main returns 1 if there are any
+
+inline int nfailures = 0;
+
+#define CHECK(condition)\
+if (!(condition)) {\
+    std::println("{}:{}: check failed: {}", __FILE__, __LINE__, #condition);\
+    nfailures++;\
+}
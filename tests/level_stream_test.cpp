@@ -0,0 +1,190 @@
+#include "level.h"
+#include "level_stream.h"
+#include "midi_builder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <vector>
+
+// Files are 96 ticks per quarter, at the default 120 BPM a second is 192 ticks and a chunk 768
+#define TICKS_PER_SECOND 192
+
+enum class TimedEventType {
+    NoteOff, // Before Note Ons of the same tick
+    NoteOn,
+    Tempo,
+};
+
+struct TimedEvent {
+    int ticks;
+    TimedEventType type;
+    uint8_t channel = 0;
+    uint8_t note = 0;
+    uint32_t usec_per_quarter = 0;
+};
+
+// Writes events sorted by tick, in the order given within a tick and type
+static std::vector<uint8_t> WriteTrack(std::vector<TimedEvent> events, int end_ticks)
+{
+    std::ranges::stable_sort(events, [](TimedEvent const& a, TimedEvent const& b) {
+        return a.ticks != b.ticks ? a.ticks < b.ticks : a.type < b.type;
+    });
+    std::vector<uint8_t> track;
+    int ticks = 0;
+    for (TimedEvent const& event : events) {
+        uint32_t delta = uint32_t(event.ticks - ticks);
+        ticks = event.ticks;
+        switch (event.type) {
+        case TimedEventType::NoteOff: AddNoteOff(track, delta, event.channel, event.note); break;
+        case TimedEventType::NoteOn: AddNoteOn(track, delta, event.channel, event.note); break;
+        case TimedEventType::Tempo: AddTempo(track, delta, event.usec_per_quarter); break;
+        }
+    }
+    AddEndOfTrack(track, uint32_t(std::max(end_ticks - ticks, 0)));
+    return track;
+}
+
+static void AddNote(std::vector<TimedEvent>& events, int start_ticks, int duration_ticks, uint8_t channel, uint8_t note)
+{
+    events.push_back(TimedEvent{ start_ticks, TimedEventType::NoteOn, channel, note });
+    events.push_back(TimedEvent{ start_ticks + duration_ticks, TimedEventType::NoteOff, channel, note });
+}
+
+// A note every half second on the first channel, for the chunks to have something to cut
+static void AddFillerNotes(std::vector<TimedEvent>& events, int end_ticks)
+{
+    for (int ticks = 0; ticks < end_ticks; ticks += TICKS_PER_SECOND / 2) {
+        AddNote(events, ticks, TICKS_PER_SECOND / 4, 0, uint8_t(40 + (ticks / 96) % 24));
+    }
+}
+
+// Drains a LevelStream of data and checks it yields the spawns BuildLevel makes, in the same order
+static void CheckStreamMatchesBuildLevel(char const* name, std::vector<uint8_t> const& data)
+{
+    std::filesystem::path filepath = std::filesystem::temp_directory_path() / std::format("imomi-level-stream-test-{}.mid", name);
+    {
+        std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+    }
+    Level level = LoadLevelMidi(filepath.string());
+
+    std::vector<LevelSpawn> streamed;
+    float length = 0.0f;
+    int nchunks = 0;
+    {
+        LevelStream stream(filepath.string());
+        float x_end = -INFINITY;
+        bool last = false;
+        while (!last) {
+            LevelChunk const& chunk = stream.Receive();
+            for (LevelSpawn const& spawn : chunk.spawns) {
+                CHECK(spawn.x >= x_end); // Promised to have all been sent
+            }
+            CHECK(chunk.x_end >= x_end);
+            x_end = chunk.x_end;
+            streamed.insert(streamed.end(), chunk.spawns.begin(), chunk.spawns.end());
+            last = chunk.last;
+            length = chunk.length;
+            nchunks++;
+            stream.Release(chunk);
+        }
+        CHECK(stream.Error().empty());
+    }
+    std::filesystem::remove(filepath);
+
+    CHECK(streamed.size() == level.spawns.size());
+    CHECK(length == level.length);
+    size_t ncompared = std::min(streamed.size(), level.spawns.size());
+    for (size_t i = 0; i < ncompared; i++) {
+        if (std::memcmp(&streamed[i], &level.spawns[i], sizeof(LevelSpawn)) != 0) {
+            LevelSpawn const& a = streamed[i];
+            LevelSpawn const& b = level.spawns[i];
+            std::println("{}: spawn {} streamed as x {} y {} type {} hp {}, built as x {} y {} type {} hp {}",
+                name, i, a.x, a.y, a.type, a.hp, b.x, b.y, b.type, b.hp);
+            nfailures++;
+            break;
+        }
+    }
+    std::println("{}: {} spawns in {} chunks", name, streamed.size(), nchunks);
+}
+
+// The tempo map comes from another track than the notes, and changes between and inside chunks
+static void TestTempoChangesInSecondTrack()
+{
+    int end_ticks = 60 * TICKS_PER_SECOND;
+    std::vector<TimedEvent> notes;
+    for (int i = 0; i * 40 < end_ticks; i++) {
+        AddNote(notes, i * 40, 10 + (i * 137) % 1000, uint8_t(i % 16), uint8_t(30 + (i * 7) % 60));
+    }
+    std::vector<TimedEvent> tempos;
+    uint32_t const usec_per_quarter[] = { 300000, 700000, 450000, 1200000 };
+    for (int i = 0; i * 500 < end_ticks; i++) {
+        tempos.push_back(TimedEvent{ i * 500 + 250, TimedEventType::Tempo, 0, 0, usec_per_quarter[i % 4] });
+    }
+    CheckStreamMatchesBuildLevel("tempo", MakeMidi({ WriteTrack(notes, end_ticks), WriteTrack(tempos, end_ticks) }));
+}
+
+// Notes released after the decoding horizon of the chunk they start in, so they are sent before
+// their Note Off is read
+static void TestNotesHeldPastHorizon()
+{
+    int end_ticks = 80 * TICKS_PER_SECOND;
+    std::vector<TimedEvent> events;
+    AddFillerNotes(events, end_ticks);
+    AddNote(events, 0, 40 * TICKS_PER_SECOND, 1, 60);
+    AddNote(events, 3 * TICKS_PER_SECOND, 6 * TICKS_PER_SECOND + 96, 1, 61);
+    AddNote(events, 20 * TICKS_PER_SECOND + 5, 70 * TICKS_PER_SECOND, 2, 62); // Past the end of the track
+    CheckStreamMatchesBuildLevel("held", MakeMidi({ WriteTrack(events, end_ticks) }));
+}
+
+// The first note of a key is sent while held, then a second one starts on the same key. The first
+// Note Off pairs with the first note, which is gone, and the second with the second note.
+static void TestNoteOffAfterPop()
+{
+    int end_ticks = 30 * TICKS_PER_SECOND;
+    std::vector<TimedEvent> events;
+    AddFillerNotes(events, end_ticks);
+    events.push_back(TimedEvent{ 0, TimedEventType::NoteOn, 3, 60 });
+    events.push_back(TimedEvent{ 14 * TICKS_PER_SECOND, TimedEventType::NoteOn, 3, 60 });
+    events.push_back(TimedEvent{ 14 * TICKS_PER_SECOND + 96, TimedEventType::NoteOff, 3, 60 });
+    events.push_back(TimedEvent{ 15 * TICKS_PER_SECOND + 96, TimedEventType::NoteOff, 3, 60 }); // 1.5 s after the second Note On
+    CheckStreamMatchesBuildLevel("popped", MakeMidi({ WriteTrack(events, end_ticks) }));
+}
+
+// More spawns at one x than fit in a chunk, in two tracks so ties are also split across chunks
+static void TestCrowdedTick()
+{
+    int end_ticks = 10 * TICKS_PER_SECOND;
+    int crowded_ticks = TICKS_PER_SECOND;
+    std::vector<TimedEvent> first;
+    AddFillerNotes(first, end_ticks);
+    for (int i = 0; i < LEVEL_CHUNK_CAPACITY + 900; i++) {
+        AddNote(first, crowded_ticks, 50 + (i % 7) * 100, uint8_t((i / 128) % 16), uint8_t(i % 128));
+    }
+    std::vector<TimedEvent> second;
+    for (int i = 0; i < 300; i++) {
+        AddNote(second, crowded_ticks, 400, uint8_t(i % 16), uint8_t(i % 128));
+    }
+    AddNote(second, crowded_ticks + 1, 100, 0, 64);
+    CheckStreamMatchesBuildLevel("crowded", MakeMidi({ WriteTrack(first, end_ticks), WriteTrack(second, end_ticks) }));
+}
+
+int main()
+{
+    TestTempoChangesInSecondTrack();
+    TestNotesHeldPastHorizon();
+    TestNoteOffAfterPop();
+    TestCrowdedTick();
+    if (nfailures) {
+        std::println("{} check(s) failed", nfailures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
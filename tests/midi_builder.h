@@ -0,0 +1,65 @@
+#pragma once
+#include "check.h"
+#include <cstdint>
+#include <vector>
+
+// Test helpers: writes MIDI files in memory
+
+inline void AppendUint32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.insert(data.end(), { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) });
+}
+
+inline void AppendVariableLengthQuantity(std::vector<uint8_t>& data, uint32_t value)
+{
+    int nbytes = 1;
+    while (nbytes < 4 && value >> (7 * nbytes)) {
+        nbytes++;
+    }
+    for (int i = nbytes - 1; i >= 0; i--) {
+        data.push_back(uint8_t((value >> (7 * i)) & 0x7f) | (i > 0 ? 0x80 : 0x00));
+    }
+}
+
+// Events of a track, delta is in ticks since the previous event
+inline void AddNoteOn(std::vector<uint8_t>& track, uint32_t delta, uint8_t channel, uint8_t note, uint8_t velocity = 0x40)
+{
+    AppendVariableLengthQuantity(track, delta);
+    track.insert(track.end(), { uint8_t(0x90 | channel), note, velocity });
+}
+
+inline void AddNoteOff(std::vector<uint8_t>& track, uint32_t delta, uint8_t channel, uint8_t note)
+{
+    AppendVariableLengthQuantity(track, delta);
+    track.insert(track.end(), { uint8_t(0x80 | channel), note, 0x00 });
+}
+
+inline void AddTempo(std::vector<uint8_t>& track, uint32_t delta, uint32_t usec_per_quarter)
+{
+    AppendVariableLengthQuantity(track, delta);
+    track.insert(track.end(), { 0xff, 0x51, 0x03, uint8_t(usec_per_quarter >> 16), uint8_t(usec_per_quarter >> 8), uint8_t(usec_per_quarter) });
+}
+
+inline void AddEndOfTrack(std::vector<uint8_t>& track, uint32_t delta)
+{
+    AppendVariableLengthQuantity(track, delta);
+    track.insert(track.end(), { 0xff, 0x2f, 0x00 });
+}
+
+// Format 1 file holding tracks as they are, format 0 with a single track
+inline std::vector<uint8_t> MakeMidi(std::vector<std::vector<uint8_t>> const& tracks, uint16_t tickdiv = 96)
+{
+    uint16_t format = tracks.size() == 1 ? 0 : 1;
+    std::vector<uint8_t> data = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6,
+        uint8_t(format >> 8), uint8_t(format),
+        uint8_t(tracks.size() >> 8), uint8_t(tracks.size()),
+        uint8_t(tickdiv >> 8), uint8_t(tickdiv),
+    };
+    for (std::vector<uint8_t> const& track : tracks) {
+        data.insert(data.end(), { 'M', 'T', 'r', 'k' });
+        AppendUint32(data, uint32_t(track.size()));
+        data.insert(data.end(), track.begin(), track.end());
+    }
+    return data;
+}
@@ -0,0 +1,54 @@
+#include "midi.h"
+#include "midi_builder.h"
+#include <cstdint>
+#include <print>
+#include <vector>
+
+static void TestNotes()
+{
+    std::vector<uint8_t> data = MakeMidi({ {
+        0x00, 0x90, 0x3c, 0x40,
+        0x60, 0x80, 0x3c, 0x00,
+        0x00, 0xff, 0x2f, 0x00,
+    } });
+    std::expected<Midi, MidiError> midi = TryLoadMidi(data);
+    CHECK(midi.has_value());
+    if (!midi) {
+        return;
+    }
+    CHECK(midi->events.size() == 1);
+    CHECK(midi->events[0].note == 0x3c);
+    CHECK(midi->events[0].duration_ticks == 96);
+    CHECK(midi->ticklen == 96);
+}
+
+// The counting pass used to skip the payload of End of Track and the filling pass didn't, so the
+// notes hidden in it were only seen by the second one and written past the counted events
+static void TestEndOfTrackPayload()
+{
+    std::vector<uint8_t> data = MakeMidi({ {
+        0x00, 0xff, 0x2f, 0x08,
+        0x00, 0x90, 0x3c, 0x40,
+        0x00, 0x90, 0x3e, 0x40,
+        0x00, 0x90, 0x3d, 0x40,
+    } });
+    std::expected<Midi, MidiError> midi = TryLoadMidi(data);
+    CHECK(midi.has_value());
+    if (!midi) {
+        return;
+    }
+    CHECK(midi->events.size() == 1);
+    CHECK(midi->events[0].note == 0x3d);
+}
+
+int main()
+{
+    TestNotes();
+    TestEndOfTrackPayload();
+    if (nfailures) {
+        std::println("{} check(s) failed", nfailures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
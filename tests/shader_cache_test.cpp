@@ -0,0 +1,168 @@
+#include "shader_cache.h"
+#include "check.h"
+#include "raylib.h"
+#include "rlgl.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+#include <vector>
+
+// Runs from the source directory, for the shader. Needs a display like the bloom test, and a driver
+// with program binaries, which Mesa llvmpipe has. The cache is written to a temporary directory.
+#define SHADER_CACHE_TEST_SIZE 64
+#define SHADER_CACHE_TEST_SHADER "Assets/threshold.fs"
+#define SHADER_CACHE_TEST_SKIPPED 77 // Return code CTest reports as skipped
+
+struct ShaderCacheTest {
+    Texture2D texture; // A gradient on both sides of the threshold
+    RenderTexture2D output;
+    Image expected; // Through the shader compiled from source
+    std::filesystem::path cache_filepath;
+};
+
+static Image RenderWithShader(ShaderCacheTest const& test, Shader shader)
+{
+    BeginTextureMode(test.output);
+        ClearBackground(BLANK);
+        BeginShaderMode(shader);
+            DrawTexture(test.texture, 0, 0, WHITE);
+        EndShaderMode();
+    EndTextureMode();
+    return LoadImageFromTexture(test.output.texture);
+}
+
+static std::vector<uint8_t> ReadCacheFile(ShaderCacheTest const& test)
+{
+    std::ifstream file(test.cache_filepath, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteCacheFile(ShaderCacheTest const& test, std::vector<uint8_t> const& data)
+{
+    std::ofstream file(test.cache_filepath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+}
+
+// Dates the cache file back, so a load that rewrites it shows
+static std::filesystem::file_time_type AgeCacheFile(ShaderCacheTest const& test)
+{
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(test.cache_filepath) - std::chrono::hours(1);
+    std::filesystem::last_write_time(test.cache_filepath, time);
+    return time;
+}
+
+// Loads the shader through cache and checks it links and renders like the one compiled from source
+static void CheckCachedShader(char const* name, ShaderCacheTest const& test, ShaderCache const& cache)
+{
+    Shader shader = LoadCachedShader(cache, SHADER_CACHE_TEST_SHADER);
+    CHECK(shader.id != rlGetShaderIdDefault());
+    Image image = RenderWithShader(test, shader);
+    bool is_same = std::memcmp(image.data, test.expected.data, GetPixelDataSize(image.width, image.height, image.format)) == 0;
+    CHECK(is_same);
+    std::println("{}: {}", name, is_same ? "same pixels" : "different pixels");
+    UnloadImage(image);
+    UnloadShader(shader);
+}
+
+// Without a cache file, the shader is compiled and its binary saved
+static void TestFirstLoad(ShaderCacheTest const& test, ShaderCache const& cache)
+{
+    CheckCachedShader("first", test, cache);
+    std::vector<uint8_t> data = ReadCacheFile(test);
+    CHECK(data.size() > sizeof(ShaderCacheFileHeader));
+}
+
+// The saved binary is given to glProgramBinary, LoadCachedShader only writes the file when it
+// compiled the shader instead
+static void TestBinaryLoad(ShaderCacheTest const& test, ShaderCache const& cache)
+{
+    std::vector<uint8_t> data = ReadCacheFile(test);
+    std::filesystem::file_time_type time = AgeCacheFile(test);
+    CheckCachedShader("binary", test, cache);
+    CHECK(std::filesystem::last_write_time(test.cache_filepath) == time);
+    CHECK(ReadCacheFile(test) == data);
+}
+
+// A file saved for other sources or another driver is compiled over
+static void TestChangedKey(ShaderCacheTest const& test, ShaderCache const& cache)
+{
+    std::vector<uint8_t> data = ReadCacheFile(test);
+    if (data.size() < sizeof(ShaderCacheFileHeader)) {
+        return;
+    }
+    data[offsetof(ShaderCacheFileHeader, key)] ^= 0xff;
+    WriteCacheFile(test, data);
+    std::filesystem::file_time_type time = AgeCacheFile(test);
+    CheckCachedShader("changed key", test, cache);
+    CHECK(std::filesystem::last_write_time(test.cache_filepath) != time);
+    std::vector<uint8_t> rewritten = ReadCacheFile(test);
+    CHECK(rewritten.size() > sizeof(ShaderCacheFileHeader));
+    if (rewritten.size() >= sizeof(ShaderCacheFileHeader)) {
+        CHECK(rewritten[offsetof(ShaderCacheFileHeader, key)] != data[offsetof(ShaderCacheFileHeader, key)]);
+    }
+}
+
+// A file cut short, as by a crash while it was written, is compiled over
+static void TestTruncated(ShaderCacheTest const& test, ShaderCache const& cache)
+{
+    std::vector<uint8_t> data = ReadCacheFile(test);
+    std::filesystem::resize_file(test.cache_filepath, (data.size() + sizeof(ShaderCacheFileHeader)) / 2);
+    std::filesystem::file_time_type time = AgeCacheFile(test);
+    CheckCachedShader("truncated", test, cache);
+    CHECK(std::filesystem::last_write_time(test.cache_filepath) != time);
+    CHECK(ReadCacheFile(test).size() == data.size());
+}
+
+int main()
+{
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(SHADER_CACHE_TEST_SIZE, SHADER_CACHE_TEST_SIZE, "ImomI shader cache test");
+    if (!IsWindowReady()) {
+        std::println("No display to open a window on, skipped");
+        return SHADER_CACHE_TEST_SKIPPED;
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "imomi-shader-cache-test";
+    std::filesystem::remove_all(directory);
+    ShaderCache cache;
+    InitShaderCache(cache, directory.string());
+    if (!cache.is_supported) {
+        std::println("No program binaries on this driver, skipped");
+        CloseWindow();
+        return SHADER_CACHE_TEST_SKIPPED;
+    }
+
+    ShaderCacheTest test;
+    Image gradient = GenImageGradientLinear(SHADER_CACHE_TEST_SIZE, SHADER_CACHE_TEST_SIZE, 90, BLACK, WHITE);
+    test.texture = LoadTextureFromImage(gradient);
+    UnloadImage(gradient);
+    test.output = LoadRenderTexture(SHADER_CACHE_TEST_SIZE, SHADER_CACHE_TEST_SIZE);
+    Shader source_shader = LoadShader(nullptr, SHADER_CACHE_TEST_SHADER);
+    test.expected = RenderWithShader(test, source_shader);
+    UnloadShader(source_shader);
+    test.cache_filepath = directory / (std::filesystem::path(SHADER_CACHE_TEST_SHADER).stem().string() + SHADER_CACHE_EXTENSION);
+
+    TestFirstLoad(test, cache);
+    TestBinaryLoad(test, cache);
+    TestChangedKey(test, cache);
+    TestTruncated(test, cache);
+
+    UnloadImage(test.expected);
+    UnloadRenderTexture(test.output);
+    UnloadTexture(test.texture);
+    CloseWindow();
+    std::filesystem::remove_all(directory);
+    if (nfailures) {
+        std::println("{} check(s) failed", nfailures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
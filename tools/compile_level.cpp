@@ -0,0 +1,23 @@
+#include "level.h"
+#include <print>
+#include <string>
+
+// Offline level compiler: turns a MIDI level into the flat spawn table loaded by LoadLevel.
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::println("Usage: {} <level.mid> [output{}]", argv[0], LEVEL_FILE_EXTENSION);
+        return 1;
+    }
+    std::string midi_filepath = argv[1];
+    std::string compiled_filepath = argc == 3 ? argv[2] : GetCompiledLevelPath(midi_filepath);
+    try {
+        Level level = LoadLevelMidi(midi_filepath);
+        SaveCompiledLevel(level, compiled_filepath);
+        std::println("{}: {} enemies, length {} px -> {}", midi_filepath, level.spawns.size(), level.length, compiled_filepath);
+    }
+    catch (std::exception& e) {
+        std::println("{}", e.what());
+        return 1;
+    }
+    return 0;
+}
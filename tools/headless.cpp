@@ -0,0 +1,222 @@
+#include "level.h"
+#include "level_stream.h"
+#include "raymath.h"
+#include "replay.h"
+#include "simulation.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HEADLESS_EXTRA_SECONDS 60 // Cutscenes and warmup on top of the level length before giving up
+
+// Scripted players, picked on the command line
+enum class Script {
+    Idle, // Only presses start
+    Fire, // Holds fire without moving
+    Track, // Follows the next enemy ahead and holds fire
+    Replay, // Inputs of a replay file, for one level
+};
+
+struct RunResult {
+    std::string filepath;
+    bool ok = false;
+    std::string error;
+    int score = 0;
+    int hits_taken = 0;
+    size_t nenemies = 0;
+    int kills = 0;
+    uint64_t ticks = 0;
+    double wall_seconds = 0.0;
+};
+
+Inputs GetScriptInputs(Script script, Simulation const& sim)
+{
+    Inputs inputs = {};
+    inputs.start = sim.just_booted;
+    if (script == Script::Idle) {
+        return inputs;
+    }
+    inputs.fire = true;
+    if (script == Script::Track) {
+        Vector2 target = { sim.camera.target.x + sim.game_width * 0.25f, sim.player.pos.y };
+        for (size_t i = sim.first_active; i < sim.spawn_cursor; i++) {
+            Entity const& enemy = sim.Enemy(i);
+            if (enemy.alive && enemy.pos.x > sim.player.pos.x) {
+                target.y = enemy.pos.y;
+                break;
+            }
+        }
+        // Proportional steering, full speed beyond 20 pixels
+        inputs.dir.x = Clamp((target.x - sim.player.pos.x) / 20.0f, -1.0f, 1.0f);
+        inputs.dir.y = Clamp((target.y - sim.player.pos.y) / 20.0f, -1.0f, 1.0f);
+    }
+    return inputs;
+}
+
+// Plays a level from boot to its end screen as fast as possible.
+// A replay is played for all of its recorded steps instead, wherever they end.
+RunResult RunLevel(std::string const& filepath, Script script, Replay replay)
+{
+    RunResult result;
+    result.filepath = filepath;
+    try {
+        LevelStream stream(filepath);
+        if (!stream.Error().empty()) {
+            result.error = stream.Error();
+            return result;
+        }
+        Simulation sim(stream, SIM_GAME_WIDTH, SIM_GAME_HEIGHT);
+        if (script == Script::Replay && replay.header.level_hash != HashLevel(LoadLevel(filepath))) {
+            result.error = "Replay was recorded on another level";
+            return result;
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        if (script == Script::Replay) {
+            Inputs inputs;
+            while (ReadReplayInputs(replay, inputs)) {
+                sim.Step(inputs);
+            }
+        }
+        else {
+            // The level length is only known once it has been streamed to the end
+            auto max_ticks = [&] {
+                return uint64_t((std::min(sim.level_length, FLT_MAX) / PIXEL_PER_SECOND + HEADLESS_EXTRA_SECONDS) * SIM_TICK_RATE);
+            };
+            while (!sim.level_end_reached && (!sim.stream_ended || sim.tick < max_ticks())) {
+                sim.Step(GetScriptInputs(script, sim));
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+        result.wall_seconds = elapsed.count();
+        result.ticks = sim.tick;
+        result.score = sim.score;
+        result.hits_taken = sim.hits_taken;
+        result.nenemies = sim.SpawnsReceived();
+        result.kills = sim.kills;
+        if (!stream.Error().empty()) {
+            result.error = stream.Error();
+            return result;
+        }
+        if (!sim.level_end_reached && script != Script::Replay) {
+            result.error = std::format("Level end not reached after {} ticks", sim.tick);
+            return result;
+        }
+        result.ok = true;
+    }
+    catch (std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
+
+// Plays levels without a window or audio, driven by a scripted player, and reports how it went.
+int main(int argc, char** argv) {
+    Script script = Script::Track;
+    Replay replay;
+    int njobs = int(std::thread::hardware_concurrency());
+    std::vector<std::string> filepaths;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--script") && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "idle") {
+                script = Script::Idle;
+            }
+            else if (name == "fire") {
+                script = Script::Fire;
+            }
+            else if (name == "track") {
+                script = Script::Track;
+            }
+            else {
+                std::println("Unknown script {}", name);
+                return 2;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc) {
+            try {
+                replay = LoadReplay(argv[++i]);
+            }
+            catch (std::exception& e) {
+                std::println("{}", e.what());
+                return 2;
+            }
+            script = Script::Replay;
+        }
+        else if (!std::strcmp(argv[i], "--jobs") && i + 1 < argc) {
+            njobs = std::atoi(argv[++i]);
+        }
+        else if (std::filesystem::is_directory(argv[i])) {
+            std::error_code ec;
+            std::vector<std::string> found;
+            for (auto const& entry : std::filesystem::recursive_directory_iterator(argv[i], ec)) {
+                auto extension = entry.path().extension();
+                if (entry.is_regular_file() && (extension == ".mid" || extension == ".midi")) {
+                    found.push_back(entry.path().string());
+                }
+            }
+            if (ec) {
+                std::println("Can't read directory {}: {}", argv[i], ec.message());
+                return 2;
+            }
+            std::ranges::sort(found);
+            filepaths.insert(filepaths.end(), found.begin(), found.end());
+        }
+        else {
+            filepaths.push_back(argv[i]);
+        }
+    }
+    if (filepaths.empty() || (script == Script::Replay && filepaths.size() != 1)) {
+        std::println("Usage: {} [--script idle|fire|track] [--jobs N] <level or directory>...", argv[0]);
+        std::println("       {} --replay <replay file> <level>", argv[0]);
+        return 2;
+    }
+    njobs = std::max(njobs, 1);
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<RunResult> results(filepaths.size());
+    std::atomic<size_t> next_file = 0;
+    auto run_levels = [&] {
+        for (size_t i = next_file++; i < filepaths.size(); i = next_file++) {
+            results[i] = RunLevel(filepaths[i], script, replay);
+        }
+    };
+    std::vector<std::jthread> workers;
+    for (int i = 1; i < njobs; i++) {
+        workers.emplace_back(run_levels);
+    }
+    run_levels();
+    workers.clear(); // Joins
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+    size_t nfailed = 0;
+    uint64_t total_ticks = 0;
+    for (RunResult const& result : results) {
+        total_ticks += result.ticks;
+        double sim_seconds = double(result.ticks) / SIM_TICK_RATE;
+        if (result.ok) {
+            std::println("OK   {}: score {}, hits {}, kills {}/{}, {:.1f} sim s in {:.3f} s ({:.0f} sim s/s)",
+                result.filepath, result.score, result.hits_taken, result.kills, result.nenemies,
+                sim_seconds, result.wall_seconds, sim_seconds / std::max(result.wall_seconds, 1e-9));
+        }
+        else {
+            nfailed++;
+            std::println("FAIL {}: {}", result.filepath, result.error);
+        }
+    }
+    double seconds = std::max(elapsed.count(), 1e-9);
+    double total_sim_seconds = double(total_ticks) / SIM_TICK_RATE;
+    std::println("{} levels, {} failed, {:.1f} sim s in {:.3f} s ({:.0f} sim s/s, {} jobs)",
+        results.size(), nfailed, total_sim_seconds, elapsed.count(), total_sim_seconds / seconds, njobs);
+    return nfailed ? 1 : 0;
+}
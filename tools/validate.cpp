@@ -0,0 +1,103 @@
+#include "level.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ValidationResult {
+    std::string filepath;
+    size_t file_size = 0;
+    size_t nevents = 0;
+    bool ok = false;
+    std::string error;
+};
+
+ValidationResult ValidateLevel(std::string const& filepath)
+{
+    ValidationResult result;
+    result.filepath = filepath;
+    try {
+        MappedFile file(filepath);
+        result.file_size = file.Size();
+        if (file.Size() > MAX_LEVEL_FILE_SIZE) {
+            result.error = "Level file too big";
+            return result;
+        }
+        std::expected<Midi, MidiError> midi = TryLoadMidi(file.Data());
+        if (!midi) {
+            result.error = std::format("{} (at byte {})", midi.error().reason, midi.error().offset);
+            return result;
+        }
+        for (Track const& track : midi->tracks) {
+            result.nevents += track.events.size();
+        }
+        result.ok = true;
+    }
+    catch (std::exception& e) { // Can't open or map the file
+        result.error = e.what();
+    }
+    return result;
+}
+
+// Checks every MIDI level of a directory tree in parallel, without starting the game.
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::println("Usage: {} <levels directory> [jobs]", argv[0]);
+        return 2;
+    }
+    int njobs = argc == 3 ? std::atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    njobs = std::max(njobs, 1);
+
+    std::vector<std::string> filepaths;
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::recursive_directory_iterator(argv[1], ec)) {
+        auto extension = entry.path().extension();
+        if (entry.is_regular_file() && (extension == ".mid" || extension == ".midi")) {
+            filepaths.push_back(entry.path().string());
+        }
+    }
+    if (ec) {
+        std::println("Can't read directory {}: {}", argv[1], ec.message());
+        return 2;
+    }
+    std::ranges::sort(filepaths);
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<ValidationResult> results(filepaths.size());
+    std::atomic<size_t> next_file = 0;
+    auto validate_files = [&] {
+        for (size_t i = next_file++; i < filepaths.size(); i = next_file++) {
+            results[i] = ValidateLevel(filepaths[i]);
+        }
+    };
+    std::vector<std::jthread> workers;
+    for (int i = 1; i < njobs; i++) {
+        workers.emplace_back(validate_files);
+    }
+    validate_files();
+    workers.clear(); // Joins
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+    size_t nfailed = 0;
+    size_t total_size = 0;
+    for (ValidationResult const& result : results) {
+        total_size += result.file_size;
+        if (result.ok) {
+            std::println("OK   {} ({} events)", result.filepath, result.nevents);
+        }
+        else {
+            nfailed++;
+            std::println("FAIL {}: {}", result.filepath, result.error);
+        }
+    }
+    double seconds = std::max(elapsed.count(), 1e-9);
+    std::println("{} files, {} failed, {:.1f} MB in {:.3f} s ({:.0f} files/s, {:.1f} MB/s, {} jobs)",
+        results.size(), nfailed, total_size / 1e6, elapsed.count(), results.size() / seconds, total_size / 1e6 / seconds, njobs);
+    return nfailed ? 1 : 0;
+}